@@ -0,0 +1,438 @@
+#include "hello_triangle_application.h"
+
+// Drives the renderer for a fixed number of frames across a set of scenarios
+// and writes one machine-readable record per run. Runs headless by default, so
+// it works on a machine without a GPU or display using Mesa's lavapipe ICD:
+//
+//     VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json ./benchmark --output results.json
+
+struct BenchmarkRun
+{
+	std::string scenario;
+	std::string parameter;
+	std::string value;
+	ApplicationConfig config;
+};
+
+struct BenchmarkResult
+{
+	BenchmarkRun run;
+	bool ok = false;
+	std::string error;
+	RunStatistics statistics;
+	uint32_t measuredFrames = 0;
+	double meanFrameMs = 0.0;
+	double p50FrameMs = 0.0;
+	double p95FrameMs = 0.0;
+	double p99FrameMs = 0.0;
+	double cpuUsPerDraw = 0.0;
+};
+
+struct BenchmarkOptions
+{
+	uint32_t frames = 300;
+	uint32_t warmupFrames = 30;
+	bool windowed = false;
+	bool verbose = false;
+	std::string format = "json";
+	std::string outputPath;
+	std::vector<std::string> scenarios;
+};
+
+static BenchmarkRun makeRun( const BenchmarkOptions &options, const std::string &scenario, const std::string &parameter, const std::string &value )
+{
+	BenchmarkRun run;
+	run.scenario = scenario;
+	run.parameter = parameter;
+	run.value = value;
+	run.config.headless = !options.windowed;
+	run.config.frameCount = options.warmupFrames + options.frames;
+	return run;
+}
+
+static std::vector<BenchmarkRun> buildRuns( const BenchmarkOptions &options )
+{
+	std::vector<BenchmarkRun> runs;
+
+	for ( uint32_t triangles : { 1u, 100u, 10000u, 100000u } )
+	{
+		BenchmarkRun run = makeRun( options, "triangles", "triangle_count", std::to_string( triangles ) );
+		run.config.triangleCount = triangles;
+		runs.push_back( run );
+	}
+
+	for ( uint32_t draws : { 1u, 10u, 100u, 1000u, 10000u } )
+	{
+		BenchmarkRun run = makeRun( options, "draws", "draw_count", std::to_string( draws ) );
+		run.config.drawCount = draws;
+		runs.push_back( run );
+	}
+
+	// Per-object draws against instanced and indirect draws of the same scene
+	for ( uint32_t objects : { 1000u, 10000u, 100000u } )
+	{
+		for ( auto drawMode : { DrawMode::Direct, DrawMode::Instanced, DrawMode::Indirect } )
+		{
+			BenchmarkRun run = makeRun( options, "draw_mode", "draw_mode/draw_count", std::string( drawModeName( drawMode ) ) + "/" + std::to_string( objects ) );
+			run.config.drawCount = objects;
+			run.config.drawMode = drawMode;
+			runs.push_back( run );
+		}
+	}
+
+	// The same zoomed-in view of 100k objects drawn indirectly, with and without culling
+	for ( bool gpuCulling : { false, true } )
+	{
+		BenchmarkRun run = makeRun( options, "culling", "gpu_culling", gpuCulling ? "on" : "off" );
+		run.config.drawCount = 100000;
+		run.config.drawMode = DrawMode::Indirect;
+		run.config.gpuCulling = gpuCulling;
+		run.config.cameraZoom = 4.0f;
+		runs.push_back( run );
+	}
+
+	// 100k streamed triangles, 3.4 MiB of vertices a frame, through rings that
+	// hold one, two and several frames of uploads
+	for ( uint32_t ringMiB : { 4u, 8u, 32u } )
+	{
+		BenchmarkRun run = makeRun( options, "upload_ring", "upload_ring_mb", std::to_string( ringMiB ) );
+		run.config.triangleCount = 100000;
+		run.config.streamVertices = true;
+		run.config.uploadRingMiB = ringMiB;
+		runs.push_back( run );
+	}
+
+	// Streaming the sample textures in and out, a new one every 10 frames, bound
+	// through the bindless table and through per-frame descriptor sets
+	for ( const char *binding : { "off", "bindless", "descriptor_sets" } )
+	{
+		BenchmarkRun run = makeRun( options, "textures", "texture_binding", binding );
+		if ( std::string( binding ) != "off" )
+		{
+			run.config.texturePaths = { "textures/checker.ppm", "textures/gradient.tga" };
+			run.config.textureSwitchFrames = 10;
+			run.config.bindlessTextures = std::string( binding ) == "bindless";
+		}
+		runs.push_back( run );
+	}
+
+	// 10k objects drawn instanced, still and animated through the per-frame uniforms
+	for ( float motion : { 0.0f, 0.5f } )
+	{
+		BenchmarkRun run = makeRun( options, "animation", "object_motion", motion > 0.0f ? "on" : "off" );
+		run.config.drawCount = 10000;
+		run.config.drawMode = DrawMode::Instanced;
+		run.config.objectMotion = motion;
+		runs.push_back( run );
+	}
+
+	// The default scene at 1080p without MSAA and with 2, 4 and 8 samples, each
+	// reporting the memory its transient attachments reserve
+	for ( uint32_t samples : { 1u, 2u, 4u, 8u } )
+	{
+		BenchmarkRun run = makeRun( options, "msaa", "msaa_samples", std::to_string( samples ) );
+		run.config.width = 1920;
+		run.config.height = 1080;
+		run.config.msaaSamples = samples;
+		runs.push_back( run );
+	}
+
+	const uint32_t resolutions[][2] = { { 640, 480 }, { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+	for ( const auto &resolution : resolutions )
+	{
+		BenchmarkRun run = makeRun( options, "resolution", "resolution", std::to_string( resolution[0] ) + "x" + std::to_string( resolution[1] ) );
+		run.config.width = resolution[0];
+		run.config.height = resolution[1];
+		runs.push_back( run );
+	}
+
+	for ( uint32_t framesInFlight = 1; framesInFlight <= MAX_FRAMES_IN_FLIGHT; framesInFlight++ )
+	{
+		BenchmarkRun run = makeRun( options, "frames_in_flight", "frames_in_flight", std::to_string( framesInFlight ) );
+		run.config.framesInFlight = framesInFlight;
+		runs.push_back( run );
+	}
+
+	// Without a swap chain there is nothing to present, so these only run windowed
+	if ( options.windowed )
+	{
+		for ( auto presentMode : { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR } )
+		{
+			BenchmarkRun run = makeRun( options, "present_mode", "present_mode", presentModeName( presentMode ) );
+			run.config.presentMode = presentMode;
+			runs.push_back( run );
+		}
+	}
+
+	if ( !options.scenarios.empty() )
+	{
+		runs.erase( std::remove_if( runs.begin(), runs.end(), [&]( const BenchmarkRun &run )
+		{
+			return std::find( options.scenarios.begin(), options.scenarios.end(), run.scenario ) == options.scenarios.end();
+		} ), runs.end() );
+	}
+
+	return runs;
+}
+
+static BenchmarkResult execute( const BenchmarkOptions &options, const BenchmarkRun &run )
+{
+	BenchmarkResult result;
+	result.run = run;
+
+	// The renderer logs setup details to stdout, which would drown the results
+	std::streambuf *coutBuffer = std::cout.rdbuf();
+	if ( !options.verbose )
+	{
+		std::cout.rdbuf( nullptr );
+	}
+
+	try
+	{
+		HelloTriangleApplication app( run.config );
+		app.run();
+		result.statistics = app.getRunStatistics();
+		result.ok = true;
+	}
+	catch ( const std::exception &e )
+	{
+		result.error = e.what();
+	}
+
+	std::cout.rdbuf( coutBuffer );
+
+	if ( !result.ok )
+	{
+		return result;
+	}
+
+	// Frame times only exist from the second frame on, and the first few frames
+	// include pipeline and cache warm-up
+	const std::vector<double> &frameMs = result.statistics.frameMs;
+	size_t skip = std::min<size_t>( options.warmupFrames, frameMs.size() );
+	std::vector<double> measured( frameMs.begin() + skip, frameMs.end() );
+
+	result.measuredFrames = static_cast<uint32_t>(measured.size());
+	if ( !measured.empty() )
+	{
+		double total = 0.0;
+		for ( double ms : measured )
+		{
+			total += ms;
+		}
+		result.meanFrameMs = total / measured.size();
+		result.p50FrameMs = FrameProfiler::percentile( measured, 0.50 );
+		result.p95FrameMs = FrameProfiler::percentile( measured, 0.95 );
+		result.p99FrameMs = FrameProfiler::percentile( measured, 0.99 );
+	}
+
+	// Per object rather than per draw call, so the draw modes compare directly
+	uint64_t drawsRecorded = static_cast<uint64_t>(result.statistics.frames) * run.config.drawCount;
+	if ( drawsRecorded > 0 )
+	{
+		result.cpuUsPerDraw = result.statistics.recordMs * 1000.0 / drawsRecorded;
+	}
+
+	return result;
+}
+
+static std::string escapeJson( const std::string &text )
+{
+	std::string escaped;
+	for ( char c : text )
+	{
+		if ( c == '"' || c == '\\' )
+		{
+			escaped += '\\';
+			escaped += c;
+		}
+		else if ( static_cast<unsigned char>(c) < 0x20 )
+		{
+			escaped += ' ';
+		}
+		else
+		{
+			escaped += c;
+		}
+	}
+	return escaped;
+}
+
+// Quoted CSV fields double the quotes inside them
+static std::string escapeCsv( const std::string &text )
+{
+	std::string escaped;
+	for ( char c : text )
+	{
+		if ( c == '"' )
+		{
+			escaped += '"';
+		}
+		escaped += c;
+	}
+	return escaped;
+}
+
+static void writeJson( std::ostream &out, const std::vector<BenchmarkResult> &results )
+{
+	out << std::fixed << std::setprecision( 4 );
+	out << "[\n";
+	for ( size_t i = 0; i < results.size(); i++ )
+	{
+		const BenchmarkResult &result = results[i];
+		out << "  { \"scenario\": \"" << result.run.scenario << "\", \"parameter\": \"" << result.run.parameter
+			<< "\", \"value\": \"" << result.run.value << "\", \"ok\": " << ( result.ok ? "true" : "false" );
+
+		if ( result.ok )
+		{
+			out << ", \"device\": \"" << escapeJson( result.statistics.deviceName ) << "\""
+				<< ", \"headless\": " << ( result.run.config.headless ? "true" : "false" )
+				<< ", \"present_mode\": \"" << ( result.run.config.headless ? "none" : presentModeName( result.statistics.presentMode ) ) << "\""
+				<< ", \"frames\": " << result.measuredFrames
+				<< ", \"frames_per_sec\": " << ( result.meanFrameMs > 0.0 ? 1000.0 / result.meanFrameMs : 0.0 )
+				<< ", \"ms_per_frame_mean\": " << result.meanFrameMs
+				<< ", \"ms_per_frame_p50\": " << result.p50FrameMs
+				<< ", \"ms_per_frame_p95\": " << result.p95FrameMs
+				<< ", \"ms_per_frame_p99\": " << result.p99FrameMs
+				<< ", \"cpu_us_per_draw\": " << result.cpuUsPerDraw
+				<< ", \"visible_objects\": " << result.statistics.meanVisibleObjects
+				<< ", \"upload_kib_per_frame\": " << result.statistics.uploadBytesPerFrame / 1024.0
+				<< ", \"upload_stall_ms\": " << result.statistics.uploadStallMs
+				<< ", \"msaa_samples\": " << result.statistics.msaaSamples
+				<< ", \"attachment_mib\": " << result.statistics.attachmentMiB
+				<< ", \"attachment_unaliased_mib\": " << result.statistics.attachmentUnaliasedMiB
+				<< ", \"perf_warnings_per_frame\": " << result.statistics.performanceWarningsPerFrame
+				<< ", \"startup_ms\": " << result.statistics.startupMs;
+		}
+		else
+		{
+			out << ", \"error\": \"" << escapeJson( result.error ) << "\"";
+		}
+
+		out << " }" << ( i + 1 < results.size() ? "," : "" ) << "\n";
+	}
+	out << "]\n";
+}
+
+static void writeCsv( std::ostream &out, const std::vector<BenchmarkResult> &results )
+{
+	out << std::fixed << std::setprecision( 4 );
+	out << "scenario,parameter,value,ok,device,present_mode,frames,frames_per_sec,ms_per_frame_mean,"
+		"ms_per_frame_p50,ms_per_frame_p95,ms_per_frame_p99,cpu_us_per_draw,visible_objects,upload_kib_per_frame,upload_stall_ms,msaa_samples,attachment_mib,attachment_unaliased_mib,perf_warnings_per_frame,startup_ms,error\n";
+
+	for ( const auto &result : results )
+	{
+		out << result.run.scenario << "," << result.run.parameter << "," << result.run.value << "," << ( result.ok ? 1 : 0 ) << ","
+			<< "\"" << escapeCsv( result.statistics.deviceName ) << "\","
+			<< ( result.run.config.headless ? "none" : presentModeName( result.statistics.presentMode ) ) << ","
+			<< result.measuredFrames << "," << ( result.meanFrameMs > 0.0 ? 1000.0 / result.meanFrameMs : 0.0 ) << ","
+			<< result.meanFrameMs << "," << result.p50FrameMs << "," << result.p95FrameMs << "," << result.p99FrameMs << ","
+			<< result.cpuUsPerDraw << "," << result.statistics.meanVisibleObjects << ","
+			<< result.statistics.uploadBytesPerFrame / 1024.0 << "," << result.statistics.uploadStallMs << ","
+			<< result.statistics.msaaSamples << "," << result.statistics.attachmentMiB << "," << result.statistics.attachmentUnaliasedMiB << ","
+			<< result.statistics.performanceWarningsPerFrame << "," << result.statistics.startupMs << ",\"" << escapeCsv( result.error ) << "\"\n";
+	}
+}
+
+static int printUsage( const char *program )
+{
+	std::cerr << "usage: " << program << " [--frames N] [--warmup N] [--windowed] [--scenario NAME]..."
+		<< " [--format json|csv] [--output FILE] [--verbose]" << std::endl
+		<< "scenarios: triangles, draws, draw_mode, culling, upload_ring, textures, animation, msaa, resolution, frames_in_flight, present_mode (windowed only)" << std::endl;
+	return EXIT_FAILURE;
+}
+
+int main( int argc, char **argv )
+{
+	BenchmarkOptions options;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		std::string arg = argv[i];
+
+		if ( arg == "--frames" && i + 1 < argc )
+		{
+			if ( !parseUint32( argv[++i], options.frames ) )
+			{
+				return printUsage( argv[0] );
+			}
+			options.frames = std::max( 1u, options.frames );
+		}
+		else if ( arg == "--warmup" && i + 1 < argc )
+		{
+			if ( !parseUint32( argv[++i], options.warmupFrames ) )
+			{
+				return printUsage( argv[0] );
+			}
+		}
+		else if ( arg == "--windowed" )
+		{
+			options.windowed = true;
+		}
+		else if ( arg == "--scenario" && i + 1 < argc )
+		{
+			options.scenarios.push_back( argv[++i] );
+		}
+		else if ( arg == "--format" && i + 1 < argc && ( std::string( argv[i + 1] ) == "json" || std::string( argv[i + 1] ) == "csv" ) )
+		{
+			options.format = argv[++i];
+		}
+		else if ( arg == "--output" && i + 1 < argc )
+		{
+			options.outputPath = argv[++i];
+		}
+		else if ( arg == "--verbose" )
+		{
+			options.verbose = true;
+		}
+		else
+		{
+			return printUsage( argv[0] );
+		}
+	}
+
+	std::vector<BenchmarkRun> runs = buildRuns( options );
+	std::vector<BenchmarkResult> results;
+	bool allOk = true;
+
+	for ( size_t i = 0; i < runs.size(); i++ )
+	{
+		std::cerr << "[" << i + 1 << "/" << runs.size() << "] " << runs[i].scenario << " " << runs[i].value << ": ";
+
+		BenchmarkResult result = execute( options, runs[i] );
+		if ( result.ok )
+		{
+			std::cerr << std::fixed << std::setprecision( 3 ) << result.meanFrameMs << " ms/frame, p99 " << result.p99FrameMs
+				<< " ms, " << result.cpuUsPerDraw << " us/draw" << std::defaultfloat << std::endl;
+		}
+		else
+		{
+			std::cerr << "failed: " << result.error << std::endl;
+			allOk = false;
+		}
+		results.push_back( result );
+	}
+
+	std::ofstream file;
+	if ( !options.outputPath.empty() )
+	{
+		file.open( options.outputPath, std::ios::trunc );
+		if ( !file.is_open() )
+		{
+			std::cerr << "could not open " << options.outputPath << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	std::ostream &out = file.is_open() ? file : std::cout;
+
+	if ( options.format == "csv" )
+	{
+		writeCsv( out, results );
+	}
+	else
+	{
+		writeJson( out, results );
+	}
+
+	return allOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
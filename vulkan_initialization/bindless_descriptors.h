@@ -0,0 +1,177 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "host_allocator.h"
+
+// Must match the size of the textures array in bindless.frag
+const uint32_t BINDLESS_TEXTURE_CAPACITY = 1024;
+
+// Every slot of the array counts against the update-after-bind limits, for
+// the fragment stage and for the set, both as a sampler and as an image
+inline bool fitsBindlessTextureLimits( const VkPhysicalDeviceVulkan12Properties &properties )
+{
+	return properties.maxPerStageDescriptorUpdateAfterBindSamplers >= BINDLESS_TEXTURE_CAPACITY &&
+		properties.maxPerStageDescriptorUpdateAfterBindSampledImages >= BINDLESS_TEXTURE_CAPACITY &&
+		properties.maxDescriptorSetUpdateAfterBindSamplers >= BINDLESS_TEXTURE_CAPACITY &&
+		properties.maxDescriptorSetUpdateAfterBindSampledImages >= BINDLESS_TEXTURE_CAPACITY;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------
+// A single descriptor set holding one large array of combined image samplers,
+// bound once per command buffer. Shaders pick an element by an index passed in
+// push constants, so switching textures between draws costs a push instead of
+// a descriptor set write and bind.
+//
+// The binding is update-after-bind and partially bound: slots are written as
+// soon as a texture is added, even while frames using other slots of the set
+// are in flight, and unwritten slots are fine as long as no shader reads them.
+// A slot may be reused once no in-flight frame can still read its old view.
+class BindlessDescriptors
+{
+public:
+	void init( VkDevice device, uint32_t capacity )
+	{
+		this->device = device;
+		this->capacity = capacity;
+
+		VkDescriptorSetLayoutBinding binding = {};
+		binding.binding = 0;
+		binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		binding.descriptorCount = capacity;
+		binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		bindingFlagsInfo.bindingCount = 1;
+		bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = &bindingFlagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		layoutInfo.bindingCount = 1;
+		layoutInfo.pBindings = &binding;
+
+		if ( vkCreateDescriptorSetLayout( device, &layoutInfo, vulkanHostAllocator, &setLayout ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create bindless descriptor set layout!" );
+		}
+
+		VkDescriptorPoolSize poolSize = {};
+		poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSize.descriptorCount = capacity;
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+		poolInfo.maxSets = 1;
+
+		if ( vkCreateDescriptorPool( device, &poolInfo, vulkanHostAllocator, &pool ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create bindless descriptor pool!" );
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = pool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &setLayout;
+
+		if ( vkAllocateDescriptorSets( device, &allocInfo, &descriptorSet ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to allocate bindless descriptor set!" );
+		}
+
+		// Lowest slots first, so the fallback texture added first lands in slot 0
+		for ( uint32_t i = capacity; i > 0; i-- )
+		{
+			freeSlots.push_back( i - 1 );
+		}
+	}
+
+	void destroy()
+	{
+		if ( pool != VK_NULL_HANDLE )
+		{
+			vkDestroyDescriptorPool( device, pool, vulkanHostAllocator );
+			vkDestroyDescriptorSetLayout( device, setLayout, vulkanHostAllocator );
+			pool = VK_NULL_HANDLE;
+		}
+	}
+
+	VkDescriptorSetLayout layout() const
+	{
+		return setLayout;
+	}
+
+	VkDescriptorSet set() const
+	{
+		return descriptorSet;
+	}
+
+	// Writes view into a free slot and returns its index
+	uint32_t add( VkImageView view, VkSampler sampler )
+	{
+		if ( freeSlots.empty() )
+		{
+			throw std::runtime_error( "bindless texture table is full!" );
+		}
+
+		uint32_t slot = freeSlots.back();
+		freeSlots.pop_back();
+
+		VkDescriptorImageInfo imageInfo = {};
+		imageInfo.sampler = sampler;
+		imageInfo.imageView = view;
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkWriteDescriptorSet descriptorWrite = {};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = descriptorSet;
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.dstArrayElement = slot;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &imageInfo;
+
+		vkUpdateDescriptorSets( device, 1, &descriptorWrite, 0, nullptr );
+
+		writeCount++;
+		peakUsed = std::max( peakUsed, capacity - static_cast<uint32_t>(freeSlots.size()) );
+		return slot;
+	}
+
+	void remove( uint32_t slot )
+	{
+		freeSlots.push_back( slot );
+	}
+
+	void report( std::ostream &out ) const
+	{
+		out << "Bindless textures: " << capacity - freeSlots.size() << " of " << capacity << " slots in use (peak "
+			<< peakUsed << "), " << writeCount << " descriptor writes" << std::endl;
+	}
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	uint32_t capacity = 0;
+
+	std::vector<uint32_t> freeSlots;
+	uint32_t peakUsed = 0;
+	uint64_t writeCount = 0;
+};
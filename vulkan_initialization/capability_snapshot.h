@@ -0,0 +1,423 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Device capabilities from earlier runs, keyed by device and driver version.
+// Only read and written when the capability cache is enabled.
+const char *const CAPABILITY_CACHE_FILE = "capability_cache.bin";
+
+// What the loader and the installed layers offer. Gathered once before the
+// instance is created, needs no instance, so it can run on another thread
+// while the window is being created.
+struct InstanceCapabilities
+{
+	uint32_t loaderVersion = VK_API_VERSION_1_0;
+	std::vector<VkExtensionProperties> extensions;
+	std::vector<VkLayerProperties> layers;
+
+	bool hasExtension( const char *name ) const
+	{
+		for ( const auto &extension : extensions )
+		{
+			if ( strcmp( extension.extensionName, name ) == 0 )
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool hasLayer( const char *name ) const
+	{
+		for ( const auto &layer : layers )
+		{
+			if ( strcmp( layer.layerName, name ) == 0 )
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+inline InstanceCapabilities probeInstanceCapabilities()
+{
+	InstanceCapabilities capabilities;
+
+	// A 1.0 loader does not export vkEnumerateInstanceVersion
+	auto enumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion) vkGetInstanceProcAddr( nullptr, "vkEnumerateInstanceVersion" );
+	if ( enumerateInstanceVersion != nullptr && enumerateInstanceVersion( &capabilities.loaderVersion ) != VK_SUCCESS )
+	{
+		capabilities.loaderVersion = VK_API_VERSION_1_0;
+	}
+
+	uint32_t extensionCount = 0;
+	if ( vkEnumerateInstanceExtensionProperties( nullptr, &extensionCount, nullptr ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "failed to enumerate instance extensions!" );
+	}
+	capabilities.extensions.resize( extensionCount );
+	if ( vkEnumerateInstanceExtensionProperties( nullptr, &extensionCount, capabilities.extensions.data() ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "failed to enumerate instance extensions!" );
+	}
+	capabilities.extensions.resize( extensionCount );
+
+	uint32_t layerCount = 0;
+	if ( vkEnumerateInstanceLayerProperties( &layerCount, nullptr ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "failed to enumerate instance layers!" );
+	}
+	capabilities.layers.resize( layerCount );
+	if ( vkEnumerateInstanceLayerProperties( &layerCount, capabilities.layers.data() ) != VK_SUCCESS )
+	{
+		throw std::runtime_error( "failed to enumerate instance layers!" );
+	}
+	capabilities.layers.resize( layerCount );
+
+	return capabilities;
+}
+
+// Everything the renderer asks of a physical device that does not depend on
+// the window surface. Probed once per device at startup, every later
+// question about the device is answered from here.
+struct DeviceCapabilities
+{
+	VkPhysicalDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties properties = {};
+	VkPhysicalDeviceFeatures features = {};
+	VkPhysicalDeviceMemoryProperties memoryProperties = {};
+	std::vector<VkQueueFamilyProperties> queueFamilies;
+	std::vector<VkExtensionProperties> extensions;
+
+	// Only known when the instance and the device support Vulkan 1.2, pNext
+	// is always null
+	bool hasVulkan12Features = false;
+	VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+	bool hasVulkan12Properties = false;
+	VkPhysicalDeviceVulkan12Properties vulkan12Properties = {};
+
+	// From VkPhysicalDeviceIDProperties, needs Vulkan 1.1. Identical GPUs
+	// share a cache entry, so this is queried on every run and never cached.
+	bool hasUuid = false;
+	uint8_t uuid[VK_UUID_SIZE] = {};
+
+	bool fromDiskCache = false;
+
+	bool hasExtension( const char *name ) const
+	{
+		for ( const auto &extension : extensions )
+		{
+			if ( strcmp( extension.extensionName, name ) == 0 )
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+// Queries everything but the properties, which the caller has already read
+// to look the device up in the disk cache, and the UUID, see probeDeviceUuid(). Touches nothing but the device, so
+// several devices can be probed at once.
+inline void probeDeviceCapabilities( VkInstance instance, uint32_t instanceApiVersion, DeviceCapabilities &capabilities )
+{
+	VkPhysicalDevice device = capabilities.device;
+
+	vkGetPhysicalDeviceFeatures( device, &capabilities.features );
+	vkGetPhysicalDeviceMemoryProperties( device, &capabilities.memoryProperties );
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties( device, &queueFamilyCount, nullptr );
+	capabilities.queueFamilies.resize( queueFamilyCount );
+	vkGetPhysicalDeviceQueueFamilyProperties( device, &queueFamilyCount, capabilities.queueFamilies.data() );
+
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties( device, nullptr, &extensionCount, nullptr );
+	capabilities.extensions.resize( extensionCount );
+	vkEnumerateDeviceExtensionProperties( device, nullptr, &extensionCount, capabilities.extensions.data() );
+	capabilities.extensions.resize( extensionCount );
+
+	uint32_t apiVersion = std::min( instanceApiVersion, capabilities.properties.apiVersion );
+	if ( apiVersion >= VK_API_VERSION_1_2 )
+	{
+		auto getPhysicalDeviceFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2) vkGetInstanceProcAddr( instance, "vkGetPhysicalDeviceFeatures2" );
+		if ( getPhysicalDeviceFeatures2 != nullptr )
+		{
+			capabilities.vulkan12Features = {};
+			capabilities.vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+			VkPhysicalDeviceFeatures2 features = {};
+			features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			features.pNext = &capabilities.vulkan12Features;
+			getPhysicalDeviceFeatures2( device, &features );
+
+			capabilities.vulkan12Features.pNext = nullptr;
+			capabilities.hasVulkan12Features = true;
+		}
+
+		auto getPhysicalDeviceProperties2 = (PFN_vkGetPhysicalDeviceProperties2) vkGetInstanceProcAddr( instance, "vkGetPhysicalDeviceProperties2" );
+		if ( getPhysicalDeviceProperties2 != nullptr )
+		{
+			capabilities.vulkan12Properties = {};
+			capabilities.vulkan12Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+			VkPhysicalDeviceProperties2 properties = {};
+			properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			properties.pNext = &capabilities.vulkan12Properties;
+			getPhysicalDeviceProperties2( device, &properties );
+
+			capabilities.vulkan12Properties.pNext = nullptr;
+			capabilities.hasVulkan12Properties = true;
+		}
+	}
+}
+
+// Reads the device UUID into capabilities, which must already hold the
+// properties. Unlike the rest it tells apart devices of the same model, so it
+// is read on every run, whether or not the capability cache has the device.
+inline void probeDeviceUuid( VkInstance instance, uint32_t instanceApiVersion, DeviceCapabilities &capabilities )
+{
+	capabilities.hasUuid = false;
+	if ( std::min( instanceApiVersion, capabilities.properties.apiVersion ) < VK_API_VERSION_1_1 )
+	{
+		return;
+	}
+
+	auto getPhysicalDeviceProperties2 = (PFN_vkGetPhysicalDeviceProperties2) vkGetInstanceProcAddr( instance, "vkGetPhysicalDeviceProperties2" );
+	if ( getPhysicalDeviceProperties2 != nullptr )
+	{
+		VkPhysicalDeviceIDProperties idProperties = {};
+		idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+		VkPhysicalDeviceProperties2 properties = {};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &idProperties;
+		getPhysicalDeviceProperties2( capabilities.device, &properties );
+
+		memcpy( capabilities.uuid, idProperties.deviceUUID, VK_UUID_SIZE );
+		capabilities.hasUuid = true;
+	}
+}
+
+// -------------------------------------------------------------------------------------------------------------------------
+// Device capabilities saved from earlier runs. An entry is only used when
+// the vendor, device, driver version, device API version, pipeline cache UUID
+// and the instance API version it was probed with all match, so a driver
+// update re-probes the device. Devices of the same model share an entry. Delete the file to re-probe after installing
+// or removing layers that add device extensions.
+class CapabilityCache
+{
+public:
+	void load( const char *path )
+	{
+		std::ifstream file( path, std::ios::binary );
+		if ( !file.is_open() )
+		{
+			std::cout << "Capability cache: no " << path << ", probing every device" << std::endl;
+			return;
+		}
+
+		uint32_t magic = 0;
+		uint32_t version = 0;
+		uint32_t entryCount = 0;
+		if ( !read( file, magic ) || !read( file, version ) || !read( file, entryCount ) || magic != MAGIC || version != FORMAT_VERSION )
+		{
+			std::cout << "Capability cache: " << path << " is from another build, discarding it" << std::endl;
+			return;
+		}
+
+		for ( uint32_t i = 0; i < entryCount; i++ )
+		{
+			Entry entry;
+			if ( !readEntry( file, entry ) )
+			{
+				std::cout << "Capability cache: " << path << " is truncated, discarding it" << std::endl;
+				entries.clear();
+				return;
+			}
+			entries.push_back( std::move( entry ) );
+		}
+	}
+
+	// Fills in everything probeDeviceCapabilities() would, from a matching
+	// entry. capabilities.properties must already be set, the device and its
+	// UUID are kept.
+	bool find( uint32_t instanceApiVersion, DeviceCapabilities &capabilities )
+	{
+		for ( const auto &entry : entries )
+		{
+			if ( entry.instanceApiVersion == instanceApiVersion && matches( entry.capabilities.properties, capabilities.properties ) )
+			{
+				DeviceCapabilities live = capabilities;
+				capabilities = entry.capabilities;
+				capabilities.device = live.device;
+				capabilities.properties = live.properties;
+				capabilities.hasUuid = live.hasUuid;
+				memcpy( capabilities.uuid, live.uuid, VK_UUID_SIZE );
+				capabilities.fromDiskCache = true;
+				hits++;
+				return true;
+			}
+		}
+		misses++;
+		return false;
+	}
+
+	void store( uint32_t instanceApiVersion, const DeviceCapabilities &capabilities )
+	{
+		for ( auto &entry : entries )
+		{
+			if ( entry.instanceApiVersion == instanceApiVersion && matches( entry.capabilities.properties, capabilities.properties ) )
+			{
+				entry.capabilities = capabilities;
+				dirty = true;
+				return;
+			}
+		}
+
+		Entry entry;
+		entry.instanceApiVersion = instanceApiVersion;
+		entry.capabilities = capabilities;
+		entries.push_back( entry );
+		dirty = true;
+	}
+
+	// Written through a temporary file, like the pipeline cache, and only
+	// when a device had to be probed
+	void save( const char *path )
+	{
+		if ( !dirty )
+		{
+			return;
+		}
+
+		std::string tempFile = std::string( path ) + ".tmp";
+		std::ofstream file( tempFile, std::ios::binary | std::ios::trunc );
+		if ( !file.is_open() )
+		{
+			std::cerr << "Capability cache: could not write " << tempFile << std::endl;
+			return;
+		}
+
+		write( file, MAGIC );
+		write( file, FORMAT_VERSION );
+		write( file, static_cast<uint32_t>(entries.size()) );
+		for ( const auto &entry : entries )
+		{
+			writeEntry( file, entry );
+		}
+		file.close();
+
+		std::remove( path );
+		if ( file.fail() || std::rename( tempFile.c_str(), path ) != 0 )
+		{
+			std::cerr << "Capability cache: could not write " << path << std::endl;
+			std::remove( tempFile.c_str() );
+			return;
+		}
+		dirty = false;
+	}
+
+	void report( std::ostream &out ) const
+	{
+		out << "Capability cache: " << hits << " devices from disk, " << misses << " probed, " << entries.size() << " entries" << std::endl;
+	}
+
+private:
+	static const uint32_t MAGIC = 0x43435656;	// "VVCC"
+	static const uint32_t FORMAT_VERSION = 1;
+
+	struct Entry
+	{
+		uint32_t instanceApiVersion = 0;
+		DeviceCapabilities capabilities;
+	};
+
+	static bool matches( const VkPhysicalDeviceProperties &cached, const VkPhysicalDeviceProperties &properties )
+	{
+		return cached.vendorID == properties.vendorID && cached.deviceID == properties.deviceID &&
+			cached.driverVersion == properties.driverVersion && cached.apiVersion == properties.apiVersion &&
+			memcmp( cached.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE ) == 0;
+	}
+
+	template <typename T>
+	static bool read( std::istream &in, T &value )
+	{
+		return static_cast<bool>(in.read( reinterpret_cast<char *>(&value), sizeof( T ) ));
+	}
+
+	template <typename T>
+	static void write( std::ostream &out, const T &value )
+	{
+		out.write( reinterpret_cast<const char *>(&value), sizeof( T ) );
+	}
+
+	template <typename T>
+	static bool readVector( std::istream &in, std::vector<T> &values )
+	{
+		uint32_t count = 0;
+		if ( !read( in, count ) || count > 4096 )
+		{
+			return false;
+		}
+		values.resize( count );
+		return count == 0 || static_cast<bool>(in.read( reinterpret_cast<char *>(values.data()), sizeof( T ) * count ));
+	}
+
+	template <typename T>
+	static void writeVector( std::ostream &out, const std::vector<T> &values )
+	{
+		write( out, static_cast<uint32_t>(values.size()) );
+		out.write( reinterpret_cast<const char *>(values.data()), sizeof( T ) * values.size() );
+	}
+
+	// The whole properties struct is stored for the key, the rest of the
+	// capabilities are plain structs without pointers
+	static bool readEntry( std::istream &in, Entry &entry )
+	{
+		DeviceCapabilities &capabilities = entry.capabilities;
+		uint32_t hasVulkan12Features = 0;
+		uint32_t hasVulkan12Properties = 0;
+		bool ok = read( in, entry.instanceApiVersion ) && read( in, capabilities.properties ) && read( in, capabilities.features ) &&
+			read( in, capabilities.memoryProperties ) && readVector( in, capabilities.queueFamilies ) && readVector( in, capabilities.extensions ) &&
+			read( in, hasVulkan12Features ) && read( in, capabilities.vulkan12Features ) &&
+			read( in, hasVulkan12Properties ) && read( in, capabilities.vulkan12Properties );
+
+		capabilities.hasVulkan12Features = hasVulkan12Features != 0;
+		capabilities.vulkan12Features.pNext = nullptr;
+		capabilities.hasVulkan12Properties = hasVulkan12Properties != 0;
+		capabilities.vulkan12Properties.pNext = nullptr;
+		return ok;
+	}
+
+	static void writeEntry( std::ostream &out, const Entry &entry )
+	{
+		const DeviceCapabilities &capabilities = entry.capabilities;
+		write( out, entry.instanceApiVersion );
+		write( out, capabilities.properties );
+		write( out, capabilities.features );
+		write( out, capabilities.memoryProperties );
+		writeVector( out, capabilities.queueFamilies );
+		writeVector( out, capabilities.extensions );
+		write( out, static_cast<uint32_t>(capabilities.hasVulkan12Features) );
+		write( out, capabilities.vulkan12Features );
+		write( out, static_cast<uint32_t>(capabilities.hasVulkan12Properties) );
+		write( out, capabilities.vulkan12Properties );
+	}
+
+	std::vector<Entry> entries;
+	bool dirty = false;
+	uint32_t hits = 0;
+	uint32_t misses = 0;
+};
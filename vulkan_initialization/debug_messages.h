@@ -0,0 +1,440 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Severities and types the debug messenger subscribes to unless configured
+// otherwise. Performance messages are always subscribed to so they can be
+// counted, whether or not they are logged.
+const VkDebugUtilsMessageSeverityFlagBitsEXT DEFAULT_DEBUG_SEVERITY = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+const VkDebugUtilsMessageTypeFlagsEXT ALL_DEBUG_MESSAGE_TYPES = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
+	VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+
+inline const char *debugSeverityName( VkDebugUtilsMessageSeverityFlagBitsEXT severity )
+{
+	switch ( severity )
+	{
+	case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT:
+		return "verbose";
+	case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT:
+		return "info";
+	case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT:
+		return "warning";
+	default:
+		return "error";
+	}
+}
+
+inline bool parseDebugSeverity( const std::string &name, VkDebugUtilsMessageSeverityFlagBitsEXT &severity )
+{
+	const VkDebugUtilsMessageSeverityFlagBitsEXT severities[ ] = { VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT,
+		VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT, VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT, VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT };
+	for ( auto candidate : severities )
+	{
+		if ( name == debugSeverityName( candidate ) )
+		{
+			severity = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Comma separated list of general, validation and performance
+inline bool parseDebugTypes( const std::string &names, VkDebugUtilsMessageTypeFlagsEXT &types )
+{
+	types = 0;
+	size_t start = 0;
+	while ( start <= names.size() )
+	{
+		size_t end = std::min( names.find( ',', start ), names.size() );
+		std::string name = names.substr( start, end - start );
+		if ( name == "general" )
+		{
+			types |= VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT;
+		}
+		else if ( name == "validation" )
+		{
+			types |= VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT;
+		}
+		else if ( name == "performance" )
+		{
+			types |= VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+		}
+		else
+		{
+			return false;
+		}
+		start = end + 1;
+	}
+	return types != 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------
+// Moves validation and debug messages off the threads that make Vulkan calls.
+//
+// The messenger callback only filters, counts and copies the message into a
+// fixed-size slot of a bounded lock-free ring, so it never blocks or
+// allocates, whichever thread the layer calls it from. A logging thread
+// drains the ring and writes to std::cerr. It prints an exact repeat of a
+// message once and only counts it afterwards. It prints at most
+// RATE_LIMIT_PER_SECOND different messages per message ID each second and
+// sums up what it held back. When the ring is full, new messages are dropped
+// and counted rather than waited on.
+//
+// Performance messages are counted separately, per frame, and these counts
+// are unaffected by the log filter.
+class DebugMessageLog
+{
+public:
+	static const uint32_t RING_CAPACITY = 256;	// power of two
+	static const uint32_t RATE_LIMIT_PER_SECOND = 5;
+
+	DebugMessageLog() = default;
+	DebugMessageLog( const DebugMessageLog & ) = delete;
+	DebugMessageLog &operator=( const DebugMessageLog & ) = delete;
+
+	~DebugMessageLog()
+	{
+		stop();
+	}
+
+	void start( VkDebugUtilsMessageSeverityFlagBitsEXT minSeverity, VkDebugUtilsMessageTypeFlagsEXT types )
+	{
+		setFilter( minSeverity, types );
+		for ( uint32_t i = 0; i < RING_CAPACITY; i++ )
+		{
+			slots[i].sequence.store( i, std::memory_order_relaxed );
+		}
+		stopping = false;
+		thread = std::thread( &DebugMessageLog::loggingThreadMain, this );
+	}
+
+	// Drains whatever is still queued and joins the logging thread
+	void stop()
+	{
+		if ( !thread.joinable() )
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock( wakeMutex );
+			stopping = true;
+		}
+		wake.notify_one();
+		thread.join();
+	}
+
+	// Takes effect for the next message, from any thread
+	void setFilter( VkDebugUtilsMessageSeverityFlagBitsEXT minSeverity, VkDebugUtilsMessageTypeFlagsEXT types )
+	{
+		this->minSeverity.store( minSeverity, std::memory_order_relaxed );
+		this->types.store( types, std::memory_order_relaxed );
+	}
+
+	// Fills in a messenger create info pointing its callback at this log. The
+	// messenger only subscribes to the severities the filter passed at start()
+	// lets through, so verbose and info messages cost nothing unless asked for;
+	// setFilter() can narrow the filter later but not widen it past that.
+	void populateCreateInfo( VkDebugUtilsMessengerCreateInfoEXT &createInfo )
+	{
+		const VkDebugUtilsMessageSeverityFlagBitsEXT severities[ ] = { VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT,
+			VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT, VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT, VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT };
+
+		createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+		for ( auto severity : severities )
+		{
+			if ( severity >= minSeverity.load() )
+			{
+				createInfo.messageSeverity |= severity;
+			}
+		}
+		createInfo.messageType = types.load() | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+		createInfo.pfnUserCallback = &messengerCallback;
+		createInfo.pUserData = this;
+	}
+
+	// Closes the frame's performance message count. Main thread only.
+	void endFrame()
+	{
+		uint64_t total = performanceMessages.load( std::memory_order_relaxed );
+		uint64_t frameMessages = total - frameStartPerformanceMessages;
+		frameStartPerformanceMessages = total;
+
+		lastFramePerformanceMessages = frameMessages;
+		peakFramePerformanceMessages = std::max( peakFramePerformanceMessages, frameMessages );
+		frameCount++;
+	}
+
+	uint64_t performanceMessageCount() const
+	{
+		return performanceMessages.load( std::memory_order_relaxed );
+	}
+
+	uint64_t framePerformanceMessages() const
+	{
+		return lastFramePerformanceMessages;
+	}
+
+	void report( std::ostream &out ) const
+	{
+		std::ios::fmtflags flags = out.flags();
+		out << std::fixed << std::setprecision( 2 );
+		out << "Debug messages: " << logged.load() << " logged, " << duplicates.load() << " duplicates, "
+			<< rateLimited.load() << " rate limited, " << filtered.load() << " filtered, " << dropped.load() << " dropped, "
+			<< performanceMessages.load() << " performance ("
+			<< ( frameCount > 0 ? static_cast<double>(performanceMessages.load()) / frameCount : 0.0 ) << " per frame, peak "
+			<< peakFramePerformanceMessages << ")" << std::endl;
+		out.flags( flags );
+	}
+
+private:
+	struct Message
+	{
+		VkDebugUtilsMessageSeverityFlagBitsEXT severity;
+		VkDebugUtilsMessageTypeFlagsEXT types;
+		int32_t idNumber;
+		char idName[128];
+		char text[1024];
+	};
+
+	// A slot is free for the producer claiming position p when its sequence is
+	// p, and holds a message for the consumer at p once it is p + 1
+	struct Slot
+	{
+		std::atomic<uint64_t> sequence{ 0 };
+		Message message;
+	};
+
+	// Per message ID, for deduplication and rate limiting on the logging thread
+	struct IdHistory
+	{
+		std::unordered_map<size_t, uint64_t> textCounts;
+		std::chrono::steady_clock::time_point windowStart;
+		uint32_t windowCount = 0;
+		uint64_t windowSuppressed = 0;
+	};
+
+	static VKAPI_ATTR VkBool32 VKAPI_CALL messengerCallback(
+		VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+		VkDebugUtilsMessageTypeFlagsEXT messageType,
+		const VkDebugUtilsMessengerCallbackDataEXT *pCallbackData,
+		void *pUserData )
+	{
+		static_cast<DebugMessageLog *>(pUserData)->push( messageSeverity, messageType, pCallbackData );
+		return VK_FALSE;
+	}
+
+	void push( VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT messageTypes, const VkDebugUtilsMessengerCallbackDataEXT *data )
+	{
+		if ( messageTypes & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT )
+		{
+			performanceMessages.fetch_add( 1, std::memory_order_relaxed );
+		}
+
+		if ( severity < minSeverity.load( std::memory_order_relaxed ) || !( messageTypes & types.load( std::memory_order_relaxed ) ) )
+		{
+			filtered.fetch_add( 1, std::memory_order_relaxed );
+			return;
+		}
+
+		// Bounded multi-producer queue: claim a position, fill its slot, then
+		// publish it by bumping the slot's sequence
+		uint64_t position = writePosition.load( std::memory_order_relaxed );
+		Slot *slot;
+		for ( ;; )
+		{
+			slot = &slots[position & ( RING_CAPACITY - 1 )];
+			int64_t difference = static_cast<int64_t>(slot->sequence.load( std::memory_order_acquire )) - static_cast<int64_t>(position);
+			if ( difference == 0 )
+			{
+				if ( writePosition.compare_exchange_weak( position, position + 1, std::memory_order_relaxed ) )
+				{
+					break;
+				}
+			}
+			else if ( difference < 0 )
+			{
+				dropped.fetch_add( 1, std::memory_order_relaxed );
+				return;
+			}
+			else
+			{
+				position = writePosition.load( std::memory_order_relaxed );
+			}
+		}
+
+		Message &message = slot->message;
+		message.severity = severity;
+		message.types = messageTypes;
+		message.idNumber = data->messageIdNumber;
+		copyTruncated( message.idName, data->pMessageIdName );
+		copyTruncated( message.text, data->pMessage );
+		slot->sequence.store( position + 1, std::memory_order_release );
+
+		wake.notify_one();
+	}
+
+	template <size_t N>
+	static void copyTruncated( char ( &destination )[N], const char *source )
+	{
+		if ( source == nullptr )
+		{
+			destination[0] = '\0';
+			return;
+		}
+		strncpy( destination, source, N - 1 );
+		destination[N - 1] = '\0';
+	}
+
+	bool pop( Message &message )
+	{
+		Slot &slot = slots[readPosition & ( RING_CAPACITY - 1 )];
+		if ( slot.sequence.load( std::memory_order_acquire ) != readPosition + 1 )
+		{
+			return false;
+		}
+
+		message = slot.message;
+		slot.sequence.store( readPosition + RING_CAPACITY, std::memory_order_release );
+		readPosition++;
+		return true;
+	}
+
+	// notify_one() from the callback is not made under the mutex, so a wakeup
+	// can be missed; the timed wait bounds how long a message can sit queued
+	void loggingThreadMain()
+	{
+		Message message;
+		for ( ;; )
+		{
+			while ( pop( message ) )
+			{
+				write( message );
+			}
+
+			std::unique_lock<std::mutex> lock( wakeMutex );
+			if ( stopping )
+			{
+				break;
+			}
+			wake.wait_for( lock, std::chrono::milliseconds( 50 ) );
+		}
+
+		while ( pop( message ) )
+		{
+			write( message );
+		}
+		flushSuppressed( std::chrono::steady_clock::now(), true );
+	}
+
+	void write( const Message &message )
+	{
+		auto now = std::chrono::steady_clock::now();
+		flushSuppressed( now, false );
+
+		IdHistory &history = histories[message.idNumber != 0 ? static_cast<size_t>(message.idNumber) : std::hash<std::string>()( message.idName )];
+
+		uint64_t &textCount = history.textCounts[std::hash<std::string>()( message.text )];
+		if ( textCount++ > 0 )
+		{
+			duplicates++;
+			return;
+		}
+
+		if ( now - history.windowStart >= std::chrono::seconds( 1 ) )
+		{
+			history.windowStart = now;
+			history.windowCount = 0;
+		}
+		if ( history.windowCount >= RATE_LIMIT_PER_SECOND )
+		{
+			history.windowSuppressed++;
+			rateLimited++;
+			return;
+		}
+		history.windowCount++;
+		logged++;
+
+		std::cerr << "[" << messageTypeName( message.types ) << "][" << debugSeverityName( message.severity ) << "] ";
+		if ( message.idName[0] != '\0' )
+		{
+			std::cerr << message.idName << " ";
+		}
+		std::cerr << "(0x" << std::hex << static_cast<uint32_t>(message.idNumber) << std::dec << "): " << message.text << std::endl;
+	}
+
+	// Reports how many messages of each ID were held back once its window ends
+	void flushSuppressed( std::chrono::steady_clock::time_point now, bool force )
+	{
+		for ( auto &entry : histories )
+		{
+			IdHistory &history = entry.second;
+			if ( history.windowSuppressed > 0 && ( force || now - history.windowStart >= std::chrono::seconds( 1 ) ) )
+			{
+				std::cerr << "[debug] " << history.windowSuppressed << " more messages with ID 0x" << std::hex << entry.first << std::dec
+					<< " suppressed" << std::endl;
+				history.windowSuppressed = 0;
+			}
+		}
+	}
+
+	static const char *messageTypeName( VkDebugUtilsMessageTypeFlagsEXT types )
+	{
+		if ( types & VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT )
+		{
+			return "validation";
+		}
+		if ( types & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT )
+		{
+			return "performance";
+		}
+		return "general";
+	}
+
+	std::atomic<VkDebugUtilsMessageSeverityFlagBitsEXT> minSeverity{ DEFAULT_DEBUG_SEVERITY };
+	std::atomic<VkDebugUtilsMessageTypeFlagsEXT> types{ ALL_DEBUG_MESSAGE_TYPES };
+
+	// About 300 KB of fixed-size messages, kept on the heap since the application object lives on the stack
+	std::unique_ptr<Slot[]> slots = std::make_unique<Slot[]>( RING_CAPACITY );
+	std::atomic<uint64_t> writePosition{ 0 };
+	uint64_t readPosition = 0;	// logging thread only
+
+	std::thread thread;
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	// Logging thread only
+	std::unordered_map<size_t, IdHistory> histories;
+
+	std::atomic<uint64_t> logged{ 0 };
+	std::atomic<uint64_t> duplicates{ 0 };
+	std::atomic<uint64_t> rateLimited{ 0 };
+	std::atomic<uint64_t> filtered{ 0 };
+	std::atomic<uint64_t> dropped{ 0 };
+	std::atomic<uint64_t> performanceMessages{ 0 };
+
+	// Main thread only, see endFrame()
+	uint64_t frameStartPerformanceMessages = 0;
+	uint64_t lastFramePerformanceMessages = 0;
+	uint64_t peakFramePerformanceMessages = 0;
+	uint64_t frameCount = 0;
+};
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bindless_descriptors.h"
+#include "capability_snapshot.h"
+
+// Environment variable naming the device to use, by index, UUID or part of its
+// name. The --device flag takes precedence.
+const char *const DEVICE_OVERRIDE_VARIABLE = "VKI_DEVICE";
+
+// One enumerated physical device. Suitable devices are ranked by score, the
+// reasons behind it are kept for the startup log.
+struct DeviceCandidate
+{
+	VkPhysicalDevice device = VK_NULL_HANDLE;
+	uint32_t index = 0;
+	VkPhysicalDeviceProperties properties = {};
+
+	// From VkPhysicalDeviceIDProperties, stable across runs and processes. Only
+	// known when the instance and the device support Vulkan 1.1.
+	bool hasUuid = false;
+	uint8_t uuid[VK_UUID_SIZE] = {};
+
+	// Why the device cannot run the renderer, empty when it can
+	std::string rejection;
+
+	int64_t score = 0;
+	std::vector<std::string> scoreReasons;
+};
+
+inline const char *deviceTypeName( VkPhysicalDeviceType type )
+{
+	switch ( type )
+	{
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+		return "discrete";
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+		return "integrated";
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+		return "virtual";
+	case VK_PHYSICAL_DEVICE_TYPE_CPU:
+		return "cpu";
+	default:
+		return "other";
+	}
+}
+
+// Canonical 8-4-4-4-12 lowercase hex form of a device UUID
+inline std::string formatDeviceUuid( const uint8_t uuid[VK_UUID_SIZE] )
+{
+	std::string text;
+	char digits[3];
+	for ( uint32_t i = 0; i < VK_UUID_SIZE; i++ )
+	{
+		if ( i == 4 || i == 6 || i == 8 || i == 10 )
+		{
+			text += '-';
+		}
+		snprintf( digits, sizeof( digits ), "%02x", uuid[i] );
+		text += digits;
+	}
+	return text;
+}
+
+inline std::string toLowerAlphanumeric( const std::string &text )
+{
+	std::string result;
+	for ( char c : text )
+	{
+		if ( std::isalnum( static_cast<unsigned char>(c) ) )
+		{
+			result += static_cast<char>(std::tolower( static_cast<unsigned char>(c) ));
+		}
+	}
+	return result;
+}
+
+// A selector of only digits is an enumeration index. Anything else matches a
+// device whose UUID equals it, dashes and case ignored, or whose name
+// contains it, ignoring case.
+inline bool matchesDeviceSelector( const std::string &selector, const DeviceCandidate &candidate )
+{
+	if ( !selector.empty() && std::all_of( selector.begin(), selector.end(), []( char c ) { return std::isdigit( static_cast<unsigned char>(c) ) != 0; } ) )
+	{
+		return std::strtoull( selector.c_str(), nullptr, 10 ) == candidate.index;
+	}
+
+	std::string wanted = toLowerAlphanumeric( selector );
+	if ( wanted.empty() )
+	{
+		return false;
+	}
+	if ( candidate.hasUuid && wanted == toLowerAlphanumeric( formatDeviceUuid( candidate.uuid ) ) )
+	{
+		return true;
+	}
+
+	std::string name = candidate.properties.deviceName;
+	std::string lowerSelector = selector;
+	std::transform( name.begin(), name.end(), name.begin(), []( unsigned char c ) { return static_cast<char>(std::tolower( c )); } );
+	std::transform( lowerSelector.begin(), lowerSelector.end(), lowerSelector.begin(), []( unsigned char c ) { return static_cast<char>(std::tolower( c )); } );
+	return name.find( lowerSelector ) != std::string::npos;
+}
+
+// Optional Vulkan 1.2 features the renderer turns on when the device has
+// them, see createLogicalDevice()
+inline bool supportsTimelineSemaphores( const DeviceCapabilities &capabilities )
+{
+	return capabilities.hasVulkan12Features && capabilities.vulkan12Features.timelineSemaphore;
+}
+
+// The bindless texture index is a push constant, so it is dynamically
+// uniform and needs no non-uniform indexing support. The whole array has to
+// fit the update-after-bind limits.
+inline bool supportsBindlessTextures( const DeviceCapabilities &capabilities )
+{
+	const VkPhysicalDeviceVulkan12Features &vulkan12Features = capabilities.vulkan12Features;
+	return capabilities.hasVulkan12Features && capabilities.hasVulkan12Properties &&
+		capabilities.features.shaderSampledImageArrayDynamicIndexing &&
+		vulkan12Features.descriptorBindingSampledImageUpdateAfterBind &&
+		vulkan12Features.descriptorBindingUpdateUnusedWhilePending &&
+		vulkan12Features.descriptorBindingPartiallyBound &&
+		fitsBindlessTextureLimits( capabilities.vulkan12Properties );
+}
+
+// Ranks a suitable device. Device type dominates: adjacent types are 20000
+// points apart and everything else adds up to at most 15548, so an
+// integrated GPU or a CPU implementation never outranks a discrete GPU, however
+// much system memory it shares. Within a type, local memory counts most, and
+// dedicated queues, newer API versions, larger limits and the optional
+// features the renderer uses break ties.
+inline void scorePhysicalDevice( DeviceCandidate &candidate, const DeviceCapabilities &capabilities )
+{
+	auto add = [&candidate]( int64_t points, const std::string &reason )
+	{
+		candidate.score += points;
+		candidate.scoreReasons.push_back( reason + " +" + std::to_string( points ) );
+	};
+
+	switch ( candidate.properties.deviceType )
+	{
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+		add( 100000, "discrete" );
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+		add( 40000, "integrated" );
+		break;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+		add( 20000, "virtual" );
+		break;
+	default:
+		break;
+	}
+
+	// 400 points per doubling of the largest device local heap above 1 MiB,
+	// counted up to 64 GiB, so at most 6400
+	const VkPhysicalDeviceMemoryProperties &memoryProperties = capabilities.memoryProperties;
+	VkDeviceSize localBytes = 0;
+	for ( uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++ )
+	{
+		if ( memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT )
+		{
+			localBytes = std::max( localBytes, memoryProperties.memoryHeaps[i].size );
+		}
+	}
+	VkDeviceSize localMiB = localBytes / ( 1024 * 1024 );
+	int64_t localDoublings = 0;
+	for ( VkDeviceSize size = localMiB; size > 1 && localDoublings < 16; size /= 2 )
+	{
+		localDoublings++;
+	}
+	add( 400 * localDoublings, std::to_string( localMiB ) + " MiB local" );
+
+	bool dedicatedCompute = false;
+	bool dedicatedTransfer = false;
+	for ( const auto &family : capabilities.queueFamilies )
+	{
+		dedicatedCompute |= ( family.queueFlags & VK_QUEUE_COMPUTE_BIT ) && !( family.queueFlags & VK_QUEUE_GRAPHICS_BIT );
+		dedicatedTransfer |= ( family.queueFlags & VK_QUEUE_TRANSFER_BIT ) && !( family.queueFlags & ( VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT ) );
+	}
+	if ( dedicatedCompute )
+	{
+		add( 2000, "compute queue" );
+	}
+	if ( dedicatedTransfer )
+	{
+		add( 2000, "transfer queue" );
+	}
+
+	if ( candidate.properties.apiVersion >= VK_MAKE_VERSION( 1, 2, 0 ) )
+	{
+		add( 1000, "Vulkan 1.2" );
+	}
+
+	const VkPhysicalDeviceLimits &limits = candidate.properties.limits;
+	if ( limits.timestampComputeAndGraphics )
+	{
+		add( 500, "timestamps" );
+	}
+	add( std::min( limits.maxImageDimension2D, 32768u ) / 16, "max 2D image " + std::to_string( limits.maxImageDimension2D ) );
+
+	const VkPhysicalDeviceFeatures &features = capabilities.features;
+	if ( features.multiDrawIndirect && features.drawIndirectFirstInstance )
+	{
+		add( 500, "multi-draw indirect" );
+	}
+	if ( features.samplerAnisotropy )
+	{
+		add( 100, "anisotropy" );
+	}
+
+	// Besides the required swap chain extension the renderer enables no device
+	// extensions, what it can use optionally comes with Vulkan 1.2
+	if ( supportsTimelineSemaphores( capabilities ) )
+	{
+		add( 500, "timeline semaphores" );
+	}
+	if ( supportsBindlessTextures( capabilities ) )
+	{
+		add( 500, "bindless textures" );
+	}
+}
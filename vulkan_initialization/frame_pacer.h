@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "frame_profiler.h"
+
+// -------------------------------------------------------------------------------------------------------------------------
+// Chooses how many frames the CPU may queue ahead of the GPU and keeps latency
+// and throughput statistics for every depth that was used.
+//
+// In adaptive mode the depth is probed one step at a time. A window in which
+// the CPU spent a large share of the frame blocked on fences suggests a deeper
+// queue could absorb the stalls, so one more frame is tried. Otherwise one less
+// frame is tried, since every queued frame adds a frame of latency. A probe is
+// kept only if it paid off: a deeper queue has to raise throughput, a shallower
+// one must not lower it. Failed probes back off for a while in that direction.
+class FramePacer
+{
+public:
+	void configure( uint32_t initialDepth, uint32_t maxDepth, bool adaptive )
+	{
+		this->maxDepth = maxDepth;
+		this->adaptive = adaptive;
+		currentDepth = std::max( 1u, std::min( initialDepth, maxDepth ) );
+		stats.assign( maxDepth + 1, DepthStats() );
+		resetWindow();
+	}
+
+	uint32_t depth() const
+	{
+		return currentDepth;
+	}
+
+	bool isAdaptive() const
+	{
+		return adaptive;
+	}
+
+	// Time from sampling input at the start of a frame until the GPU finished it
+	void addLatency( double ms )
+	{
+		std::deque<double> &samples = stats[currentDepth].latencies;
+		samples.push_back( ms );
+		if ( samples.size() > MAX_LATENCY_SAMPLES )
+		{
+			samples.pop_front();
+		}
+	}
+
+	// Called once per frame. Returns true when the depth changed, in which case
+	// the caller starts using depth() from the next frame on.
+	bool endFrame( double frameMs, double blockedMs )
+	{
+		if ( frameMs <= 0.0 )
+		{
+			return false;
+		}
+
+		DepthStats &depthStats = stats[currentDepth];
+		depthStats.frames++;
+		depthStats.totalFrameMs += frameMs;
+		depthStats.totalBlockedMs += blockedMs;
+
+		if ( !adaptive )
+		{
+			return false;
+		}
+
+		// Let the queue fill up or drain before judging a new depth
+		if ( warmupFrames > 0 )
+		{
+			warmupFrames--;
+			return false;
+		}
+
+		windowFrames++;
+		windowFrameMs += frameMs;
+		windowBlockedMs += blockedMs;
+		if ( windowFrames < WINDOW_FRAMES )
+		{
+			return false;
+		}
+
+		double meanFrameMs = windowFrameMs / windowFrames;
+		double blockedFraction = windowBlockedMs / windowFrameMs;
+		resetWindow();
+
+		raiseCooldown = raiseCooldown > 0 ? raiseCooldown - 1 : 0;
+		lowerCooldown = lowerCooldown > 0 ? lowerCooldown - 1 : 0;
+
+		if ( probe != Probe::None )
+		{
+			bool raised = probe == Probe::Raise;
+			bool keep = raised ? meanFrameMs < probeBaselineMs * ( 1.0 - THROUGHPUT_TOLERANCE )
+				: meanFrameMs <= probeBaselineMs * ( 1.0 + THROUGHPUT_TOLERANCE );
+			probe = Probe::None;
+
+			if ( keep )
+			{
+				std::cout << "Frames in flight: keeping " << currentDepth << " (" << std::fixed << std::setprecision( 3 )
+					<< probeBaselineMs << " -> " << meanFrameMs << " ms/frame)" << std::defaultfloat << std::endl;
+				return false;
+			}
+
+			( raised ? raiseCooldown : lowerCooldown ) = BACKOFF_WINDOWS;
+			return setDepth( raised ? currentDepth - 1 : currentDepth + 1, "reverting probe", blockedFraction );
+		}
+
+		if ( blockedFraction > BLOCKED_HIGH && currentDepth < maxDepth && raiseCooldown == 0 )
+		{
+			probe = Probe::Raise;
+			probeBaselineMs = meanFrameMs;
+			return setDepth( currentDepth + 1, "probing up", blockedFraction );
+		}
+
+		if ( currentDepth > 1 && lowerCooldown == 0 )
+		{
+			probe = Probe::Lower;
+			probeBaselineMs = meanFrameMs;
+			return setDepth( currentDepth - 1, "probing down", blockedFraction );
+		}
+
+		return false;
+	}
+
+	void report( std::ostream &out ) const
+	{
+		std::ios::fmtflags flags = out.flags();
+		out << std::fixed << std::setprecision( 3 );
+		out << "Frames in flight (latency is input sample to GPU completion, excluding scanout):" << std::endl;
+
+		for ( uint32_t depth = 1; depth < stats.size(); depth++ )
+		{
+			const DepthStats &depthStats = stats[depth];
+			if ( depthStats.frames == 0 )
+			{
+				continue;
+			}
+
+			std::vector<double> latencies( depthStats.latencies.begin(), depthStats.latencies.end() );
+			double meanFrameMs = depthStats.totalFrameMs / depthStats.frames;
+
+			out << "  " << depth << ": " << depthStats.frames << " frames, " << 1000.0 / meanFrameMs << " frames/s, "
+				<< meanFrameMs << " ms/frame, cpu blocked " << 100.0 * depthStats.totalBlockedMs / depthStats.totalFrameMs << "%";
+			if ( !latencies.empty() )
+			{
+				out << ", latency p50/p95 " << FrameProfiler::percentile( latencies, 0.50 ) << "/"
+					<< FrameProfiler::percentile( latencies, 0.95 ) << " ms";
+			}
+			out << std::endl;
+		}
+		out.flags( flags );
+	}
+
+private:
+	enum class Probe
+	{
+		None,
+		Raise,
+		Lower
+	};
+
+	struct DepthStats
+	{
+		uint64_t frames = 0;
+		double totalFrameMs = 0.0;
+		double totalBlockedMs = 0.0;
+		std::deque<double> latencies;
+	};
+
+	static const uint32_t WINDOW_FRAMES = 120;
+	static const uint32_t BACKOFF_WINDOWS = 10;
+	static const size_t MAX_LATENCY_SAMPLES = 4096;
+	static constexpr double BLOCKED_HIGH = 0.10;
+	static constexpr double THROUGHPUT_TOLERANCE = 0.03;
+
+	uint32_t currentDepth = 2;
+	uint32_t maxDepth = 2;
+	bool adaptive = false;
+	std::vector<DepthStats> stats;
+
+	uint32_t warmupFrames = 0;
+	uint32_t windowFrames = 0;
+	double windowFrameMs = 0.0;
+	double windowBlockedMs = 0.0;
+
+	Probe probe = Probe::None;
+	double probeBaselineMs = 0.0;
+	uint32_t raiseCooldown = 0;
+	uint32_t lowerCooldown = 0;
+
+	void resetWindow()
+	{
+		windowFrames = 0;
+		windowFrameMs = 0.0;
+		windowBlockedMs = 0.0;
+	}
+
+	bool setDepth( uint32_t depth, const char *reason, double blockedFraction )
+	{
+		std::cout << "Frames in flight: " << currentDepth << " -> " << depth << " (" << reason << ", cpu blocked "
+			<< std::fixed << std::setprecision( 1 ) << blockedFraction * 100.0 << "%)" << std::defaultfloat << std::endl;
+
+		currentDepth = depth;
+		warmupFrames = depth * 2;
+		resetWindow();
+		return true;
+	}
+};
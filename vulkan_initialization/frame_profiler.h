@@ -0,0 +1,312 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// CPU-side sections of a frame that are timed individually
+enum class CpuSpan
+{
+	WaitForFrameFence,
+	WaitForImageFence,
+	AcquireImage,
+	RecordCommands,
+	QueueSubmit,
+	QueuePresent,
+	Count
+};
+
+inline const char *cpuSpanName( CpuSpan span )
+{
+	switch ( span )
+	{
+	case CpuSpan::WaitForFrameFence: return "wait_frame_fence";
+	case CpuSpan::WaitForImageFence: return "wait_image_fence";
+	case CpuSpan::AcquireImage:      return "acquire";
+	case CpuSpan::RecordCommands:    return "record";
+	case CpuSpan::QueueSubmit:       return "submit";
+	case CpuSpan::QueuePresent:      return "present";
+	default:                         return "unknown";
+	}
+}
+
+// -------------------------------------------------------------------------------------------------------------------------
+// Collects per-frame CPU spans and GPU times, keeps a rolling window of the most
+// recent frames for percentile reporting and optionally streams every frame to
+// a CSV file.
+//
+// GPU times arrive a few frames late (once the frame's fence has signaled), so
+// frames are only written to the CSV once they are older than gpuLatencyFrames.
+class FrameProfiler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	struct FrameRecord
+	{
+		uint64_t frameNumber = 0;
+		double frameMs = 0.0;
+		double spanMs[static_cast<size_t>(CpuSpan::Count)] = {};
+		double gpuMs = -1.0;	// negative until the timestamps have been read back
+
+		// Time the CPU spent waiting on the GPU or the presentation engine
+		double blockedMs() const
+		{
+			return spanMs[static_cast<size_t>(CpuSpan::WaitForFrameFence)] +
+				spanMs[static_cast<size_t>(CpuSpan::WaitForImageFence)] +
+				spanMs[static_cast<size_t>(CpuSpan::AcquireImage)];
+		}
+	};
+
+	// RAII helper that adds the time between construction and destruction to a span
+	class ScopedSpan
+	{
+	public:
+		ScopedSpan( FrameProfiler &profiler, CpuSpan span )
+			: profiler( profiler ), span( span ), start( profiler.enabled ? Clock::now() : Clock::time_point() )
+		{
+		}
+
+		~ScopedSpan()
+		{
+			if ( profiler.enabled )
+			{
+				profiler.addSpan( span, std::chrono::duration<double, std::milli>( Clock::now() - start ).count() );
+			}
+		}
+
+	private:
+		FrameProfiler &profiler;
+		CpuSpan span;
+		Clock::time_point start;
+	};
+
+	void enable( size_t windowSize, uint32_t gpuLatencyFrames, double reportIntervalSeconds )
+	{
+		enabled = true;
+		this->windowSize = windowSize;
+		this->gpuLatencyFrames = gpuLatencyFrames;
+		this->reportIntervalSeconds = reportIntervalSeconds;
+		lastReport = Clock::now();
+	}
+
+	bool isEnabled() const
+	{
+		return enabled;
+	}
+
+	void openCsv( const std::string &path )
+	{
+		csv.open( path, std::ios::trunc );
+		if ( !csv.is_open() )
+		{
+			std::cerr << "profiler: could not open " << path << std::endl;
+			return;
+		}
+
+		csv << "frame,frame_ms,blocked_ms";
+		for ( size_t i = 0; i < static_cast<size_t>(CpuSpan::Count); i++ )
+		{
+			csv << "," << cpuSpanName( static_cast<CpuSpan>(i) ) << "_ms";
+		}
+		csv << ",gpu_ms\n";
+	}
+
+	void beginFrame( uint64_t frameNumber )
+	{
+		if ( !enabled )
+		{
+			return;
+		}
+
+		Clock::time_point now = Clock::now();
+
+		current = FrameRecord();
+		current.frameNumber = frameNumber;
+		current.frameMs = hasPreviousFrame ? std::chrono::duration<double, std::milli>( now - previousFrameStart ).count() : 0.0;
+
+		previousFrameStart = now;
+		hasPreviousFrame = true;
+	}
+
+	void addSpan( CpuSpan span, double ms )
+	{
+		current.spanMs[static_cast<size_t>(span)] += ms;
+	}
+
+	void endFrame()
+	{
+		if ( !enabled )
+		{
+			return;
+		}
+
+		// The first frame has no predecessor to measure its period against
+		if ( current.frameMs > 0.0 )
+		{
+			frames.push_back( current );
+		}
+
+		while ( !frames.empty() && frames.size() > windowSize )
+		{
+			frames.pop_front();
+		}
+
+		pendingCsv.push_back( current );
+		if ( current.frameNumber >= gpuLatencyFrames )
+		{
+			flushCsv( current.frameNumber - gpuLatencyFrames );
+		}
+	}
+
+	void addGpuTime( uint64_t frameNumber, double ms )
+	{
+		if ( !enabled )
+		{
+			return;
+		}
+
+		gpuTimes.push_back( ms );
+		while ( gpuTimes.size() > windowSize )
+		{
+			gpuTimes.pop_front();
+		}
+
+		for ( auto &record : pendingCsv )
+		{
+			if ( record.frameNumber == frameNumber )
+			{
+				record.gpuMs = ms;
+				break;
+			}
+		}
+	}
+
+	// Prints a summary line once every reportIntervalSeconds
+	void reportPeriodically( std::ostream &out )
+	{
+		if ( !enabled || std::chrono::duration<double>( Clock::now() - lastReport ).count() < reportIntervalSeconds )
+		{
+			return;
+		}
+
+		report( out );
+		lastReport = Clock::now();
+	}
+
+	void report( std::ostream &out ) const
+	{
+		if ( !enabled || frames.empty() )
+		{
+			return;
+		}
+
+		std::vector<double> frameTimes;
+		std::vector<double> blockedTimes;
+		for ( const auto &record : frames )
+		{
+			frameTimes.push_back( record.frameMs );
+			blockedTimes.push_back( record.blockedMs() );
+		}
+
+		std::ios::fmtflags flags = out.flags();
+		out << std::fixed << std::setprecision( 3 );
+		out << "frame ms p50/p95/p99 " << formatPercentiles( frameTimes );
+		out << " | cpu blocked " << formatPercentiles( blockedTimes );
+		if ( !gpuTimes.empty() )
+		{
+			out << " | gpu " << formatPercentiles( std::vector<double>( gpuTimes.begin(), gpuTimes.end() ) );
+		}
+		out << " | " << frames.size() << " frames" << std::endl;
+
+		out << "  mean cpu spans (ms):";
+		for ( size_t i = 0; i < static_cast<size_t>(CpuSpan::Count); i++ )
+		{
+			double total = 0.0;
+			for ( const auto &record : frames )
+			{
+				total += record.spanMs[i];
+			}
+			out << " " << cpuSpanName( static_cast<CpuSpan>(i) ) << "=" << total / frames.size();
+		}
+		out << std::endl;
+		out.flags( flags );
+	}
+
+	// Writes out every frame still waiting for its GPU time
+	void finish()
+	{
+		flushCsv( UINT64_MAX );
+		if ( csv.is_open() )
+		{
+			csv.close();
+		}
+	}
+
+	static double percentile( std::vector<double> values, double p )
+	{
+		if ( values.empty() )
+		{
+			return 0.0;
+		}
+
+		size_t index = std::min( values.size() - 1, static_cast<size_t>( p * ( values.size() - 1 ) + 0.5 ) );
+		std::nth_element( values.begin(), values.begin() + index, values.end() );
+		return values[index];
+	}
+
+private:
+	bool enabled = false;
+	size_t windowSize = 1000;
+	uint32_t gpuLatencyFrames = 4;
+	double reportIntervalSeconds = 2.0;
+
+	FrameRecord current;
+	Clock::time_point previousFrameStart;
+	bool hasPreviousFrame = false;
+	Clock::time_point lastReport;
+
+	std::deque<FrameRecord> frames;
+	std::deque<double> gpuTimes;
+
+	std::ofstream csv;
+	std::deque<FrameRecord> pendingCsv;
+
+	static std::string formatPercentiles( const std::vector<double> &values )
+	{
+		std::ostringstream text;
+		text << std::fixed << std::setprecision( 3 )
+			<< percentile( values, 0.50 ) << "/" << percentile( values, 0.95 ) << "/" << percentile( values, 0.99 );
+		return text.str();
+	}
+
+	void flushCsv( uint64_t upToFrame )
+	{
+		while ( !pendingCsv.empty() && pendingCsv.front().frameNumber <= upToFrame )
+		{
+			const FrameRecord &record = pendingCsv.front();
+			if ( csv.is_open() )
+			{
+				csv << record.frameNumber << "," << record.frameMs << "," << record.blockedMs();
+				for ( size_t i = 0; i < static_cast<size_t>(CpuSpan::Count); i++ )
+				{
+					csv << "," << record.spanMs[i];
+				}
+				csv << ",";
+				if ( record.gpuMs >= 0.0 )
+				{
+					csv << record.gpuMs;
+				}
+				csv << "\n";
+			}
+			pendingCsv.pop_front();
+		}
+	}
+};
@@ -0,0 +1,343 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "host_allocator.h"
+
+// A sub-allocation inside one of the allocator's VkDeviceMemory blocks
+struct GpuAllocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void *mapped = nullptr;	// host-visible blocks stay mapped for their whole lifetime
+	uint32_t blockIndex = UINT32_MAX;
+};
+
+struct GpuBuffer
+{
+	VkBuffer buffer = VK_NULL_HANDLE;
+	GpuAllocation allocation;
+};
+
+// -------------------------------------------------------------------------------------------------------------------------
+// Hands out ranges of a few large VkDeviceMemory blocks instead of calling
+// vkAllocateMemory per resource, since maxMemoryAllocationCount can be as low
+// as 4096. Blocks are keyed by memory type and by whether they hold linear
+// resources (buffers, linear images) or optimal-tiling images, so neighbouring
+// allocations never have to be padded out to bufferImageGranularity.
+//
+// Free space in each block is a sorted list of ranges, allocated first-fit and
+// coalesced on free. Not thread-safe, all calls are made from the main thread.
+class GpuAllocator
+{
+public:
+	struct Stats
+	{
+		uint32_t blockCount = 0;
+		uint32_t allocationCount = 0;
+		VkDeviceSize bytesReserved = 0;	// sum of all block sizes
+		VkDeviceSize bytesUsed = 0;
+		VkDeviceSize largestFreeRange = 0;
+
+		// 0 when all free space is one contiguous range, approaching 1 as it
+		// splinters into many small ones
+		double fragmentation = 0.0;
+	};
+
+	void init( VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize = 64 * 1024 * 1024 )
+	{
+		this->device = device;
+		this->blockSize = blockSize;
+		vkGetPhysicalDeviceMemoryProperties( physicalDevice, &memProperties );
+	}
+
+	void destroy()
+	{
+		for ( auto &block : blocks )
+		{
+			releaseBlock( block );
+		}
+		blocks.clear();
+	}
+
+	uint32_t findMemoryType( uint32_t typeFilter, VkMemoryPropertyFlags properties ) const
+	{
+		for ( uint32_t i = 0; i < memProperties.memoryTypeCount; i++ )
+		{
+			if ( ( typeFilter & ( 1 << i ) ) && ( memProperties.memoryTypes[i].propertyFlags & properties ) == properties )
+			{
+				return i;
+			}
+		}
+
+		throw std::runtime_error( "failed to find suitable memory type!" );
+	}
+
+	// For optional properties such as VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+	// checked before asking allocate() for them
+	bool hasMemoryType( uint32_t typeFilter, VkMemoryPropertyFlags properties ) const
+	{
+		for ( uint32_t i = 0; i < memProperties.memoryTypeCount; i++ )
+		{
+			if ( ( typeFilter & ( 1 << i ) ) && ( memProperties.memoryTypes[i].propertyFlags & properties ) == properties )
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	GpuAllocation allocate( const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool linear )
+	{
+		uint32_t memoryType = findMemoryType( requirements.memoryTypeBits, properties );
+
+		for ( uint32_t i = 0; i < blocks.size(); i++ )
+		{
+			Block &block = blocks[i];
+			if ( block.memory != VK_NULL_HANDLE && block.memoryType == memoryType && block.linear == linear )
+			{
+				GpuAllocation allocation;
+				if ( allocateFromBlock( i, requirements, allocation ) )
+				{
+					return allocation;
+				}
+			}
+		}
+
+		// Oversized requests get a block of their own
+		uint32_t blockIndex = createBlock( memoryType, linear, std::max( blockSize, requirements.size ) );
+
+		GpuAllocation allocation;
+		if ( !allocateFromBlock( blockIndex, requirements, allocation ) )
+		{
+			throw std::runtime_error( "failed to sub-allocate device memory!" );
+		}
+		return allocation;
+	}
+
+	void free( GpuAllocation &allocation )
+	{
+		if ( allocation.blockIndex == UINT32_MAX )
+		{
+			return;
+		}
+
+		Block &block = blocks[allocation.blockIndex];
+
+		auto next = std::lower_bound( block.freeRanges.begin(), block.freeRanges.end(), allocation.offset,
+			[]( const Range &range, VkDeviceSize offset ) { return range.offset < offset; } );
+		next = block.freeRanges.insert( next, { allocation.offset, allocation.size } );
+
+		// Coalesce with the following and preceding ranges
+		if ( next + 1 != block.freeRanges.end() && next->offset + next->size == ( next + 1 )->offset )
+		{
+			next->size += ( next + 1 )->size;
+			block.freeRanges.erase( next + 1 );
+		}
+		if ( next != block.freeRanges.begin() && ( next - 1 )->offset + ( next - 1 )->size == next->offset )
+		{
+			( next - 1 )->size += next->size;
+			block.freeRanges.erase( next );
+		}
+
+		block.bytesUsed -= allocation.size;
+		block.allocationCount--;
+
+		// Keep one empty block per memory type around so a free/allocate pattern
+		// does not bounce vkAllocateMemory/vkFreeMemory
+		if ( block.allocationCount == 0 && hasOtherEmptyBlock( allocation.blockIndex ) )
+		{
+			releaseBlock( block );
+		}
+
+		allocation = GpuAllocation();
+	}
+
+	Stats getStats() const
+	{
+		Stats stats;
+		VkDeviceSize bytesFree = 0;
+
+		for ( const auto &block : blocks )
+		{
+			if ( block.memory == VK_NULL_HANDLE )
+			{
+				continue;
+			}
+
+			stats.blockCount++;
+			stats.allocationCount += block.allocationCount;
+			stats.bytesReserved += block.size;
+			stats.bytesUsed += block.bytesUsed;
+
+			for ( const auto &range : block.freeRanges )
+			{
+				bytesFree += range.size;
+				stats.largestFreeRange = std::max( stats.largestFreeRange, range.size );
+			}
+		}
+
+		if ( bytesFree > 0 )
+		{
+			stats.fragmentation = 1.0 - static_cast<double>(stats.largestFreeRange) / bytesFree;
+		}
+		return stats;
+	}
+
+	void report( std::ostream &out ) const
+	{
+		Stats stats = getStats();
+
+		std::ios::fmtflags flags = out.flags();
+		out << std::fixed << std::setprecision( 2 );
+		out << "GPU memory: " << stats.allocationCount << " allocations in " << stats.blockCount << " blocks, "
+			<< stats.bytesUsed / 1024.0 << " KiB used of " << stats.bytesReserved / 1024.0 << " KiB reserved, "
+			<< "fragmentation " << stats.fragmentation * 100.0 << "%" << std::endl;
+		out.flags( flags );
+	}
+
+private:
+	struct Range
+	{
+		VkDeviceSize offset;
+		VkDeviceSize size;
+	};
+
+	struct Block
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memoryType = 0;
+		bool linear = true;
+		void *mapped = nullptr;
+
+		std::vector<Range> freeRanges;	// sorted by offset
+		VkDeviceSize bytesUsed = 0;
+		uint32_t allocationCount = 0;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkDeviceSize blockSize = 0;
+	VkPhysicalDeviceMemoryProperties memProperties = {};
+	std::vector<Block> blocks;
+
+	uint32_t createBlock( uint32_t memoryType, bool linear, VkDeviceSize size )
+	{
+		Block block;
+		block.size = size;
+		block.memoryType = memoryType;
+		block.linear = linear;
+		block.freeRanges.push_back( { 0, size } );
+
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryType;
+
+		if ( vkAllocateMemory( device, &allocInfo, vulkanHostAllocator, &block.memory ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to allocate device memory block!" );
+		}
+
+		if ( memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT )
+		{
+			if ( vkMapMemory( device, block.memory, 0, VK_WHOLE_SIZE, 0, &block.mapped ) != VK_SUCCESS )
+			{
+				throw std::runtime_error( "failed to map device memory block!" );
+			}
+		}
+
+		// Reuse the slot of a released block so existing block indices stay valid
+		for ( uint32_t i = 0; i < blocks.size(); i++ )
+		{
+			if ( blocks[i].memory == VK_NULL_HANDLE )
+			{
+				blocks[i] = std::move( block );
+				return i;
+			}
+		}
+
+		blocks.push_back( std::move( block ) );
+		return static_cast<uint32_t>(blocks.size() - 1);
+	}
+
+	void releaseBlock( Block &block )
+	{
+		if ( block.memory == VK_NULL_HANDLE )
+		{
+			return;
+		}
+
+		if ( block.mapped )
+		{
+			vkUnmapMemory( device, block.memory );
+		}
+		vkFreeMemory( device, block.memory, vulkanHostAllocator );
+		block = Block();
+	}
+
+	bool hasOtherEmptyBlock( uint32_t blockIndex ) const
+	{
+		const Block &block = blocks[blockIndex];
+		for ( uint32_t i = 0; i < blocks.size(); i++ )
+		{
+			const Block &other = blocks[i];
+			if ( i != blockIndex && other.memory != VK_NULL_HANDLE && other.allocationCount == 0 &&
+				other.memoryType == block.memoryType && other.linear == block.linear )
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool allocateFromBlock( uint32_t blockIndex, const VkMemoryRequirements &requirements, GpuAllocation &allocation )
+	{
+		Block &block = blocks[blockIndex];
+		VkDeviceSize alignment = std::max<VkDeviceSize>( requirements.alignment, 1 );
+
+		for ( size_t i = 0; i < block.freeRanges.size(); i++ )
+		{
+			Range range = block.freeRanges[i];
+			VkDeviceSize alignedOffset = ( range.offset + alignment - 1 ) / alignment * alignment;
+			if ( alignedOffset + requirements.size > range.offset + range.size )
+			{
+				continue;
+			}
+
+			// Replace the range with whatever is left on either side of the allocation
+			VkDeviceSize padding = alignedOffset - range.offset;
+			VkDeviceSize remainder = range.offset + range.size - ( alignedOffset + requirements.size );
+
+			block.freeRanges.erase( block.freeRanges.begin() + i );
+			if ( remainder > 0 )
+			{
+				block.freeRanges.insert( block.freeRanges.begin() + i, { alignedOffset + requirements.size, remainder } );
+			}
+			if ( padding > 0 )
+			{
+				block.freeRanges.insert( block.freeRanges.begin() + i, { range.offset, padding } );
+			}
+
+			block.bytesUsed += requirements.size;
+			block.allocationCount++;
+
+			allocation.memory = block.memory;
+			allocation.offset = alignedOffset;
+			allocation.size = requirements.size;
+			allocation.mapped = block.mapped ? static_cast<char *>(block.mapped) + alignedOffset : nullptr;
+			allocation.blockIndex = blockIndex;
+			return true;
+		}
+
+		return false;
+	}
+};
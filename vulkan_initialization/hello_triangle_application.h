@@ -0,0 +1,4330 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include  <GLFW/glfw3.h>
+
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <vector>
+#include <optional>
+#include <set>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <future>
+#include <functional>
+
+#include "capability_snapshot.h"
+#include "debug_messages.h"
+#include "device_selection.h"
+#include "frame_pacer.h"
+#include "frame_profiler.h"
+#include "gpu_allocator.h"
+#include "host_allocator.h"
+#include "pipeline_registry.h"
+#include "render_graph.h"
+#include "transient_allocator.h"
+#include "shader_cache.h"
+#include "startup_timer.h"
+#include "texture_cache.h"
+#include "timeline_semaphore.h"
+#include "uniform_ring.h"
+#include "upload_ring.h"
+#include "worker_pool.h"
+
+const uint32_t WIDTH = 800;
+const uint32_t HEIGHT = 600;
+
+// Upper bound for the frames in flight setting. Adaptive mode allocates this
+// many frame slots up front and moves between 1 and this depth.
+const uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+// Number of app-owned render targets cycled through in headless mode. Mirrors
+// the usual minImageCount + 1 of a swap chain so the same frames-in-flight
+// logic applies.
+const uint32_t HEADLESS_IMAGE_COUNT = 3;
+const uint32_t HEADLESS_DEFAULT_FRAME_COUNT = 1000;
+
+// Driver pipeline cache blob, loaded at startup and written back on exit
+const char *const PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+
+// Must match local_size_x in cull.comp
+const uint32_t CULLING_GROUP_SIZE = 64;
+
+// Graphics queue stages that consume the output of the culling pass
+const VkPipelineStageFlags CULLING_OUTPUT_STAGES = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+// Graphics queue stages and accesses that read data streamed through the upload ring
+const VkPipelineStageFlags UPLOAD_CONSUMER_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+const VkAccessFlags UPLOAD_CONSUMER_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+const std::vector<const char *> validationLayers = {
+	"VK_LAYER_KHRONOS_validation"
+};
+
+const std::vector<const char *> deviceExtensions = {
+	VK_KHR_SWAPCHAIN_EXTENSION_NAME
+};
+
+#ifdef NDEBUG
+const bool enableValidationLayers = false;
+#else
+const bool enableValidationLayers = true;
+#endif
+
+inline VkResult CreateDebugUtilsMessengerEXT(
+	VkInstance instance,
+	const VkDebugUtilsMessengerCreateInfoEXT *pCreateInfo,
+	const VkAllocationCallbacks *pAllocator,
+	VkDebugUtilsMessengerEXT *pDebugMessenger )
+{
+	auto func = (PFN_vkCreateDebugUtilsMessengerEXT) vkGetInstanceProcAddr( instance, "vkCreateDebugUtilsMessengerEXT" );
+
+	if ( func != nullptr )
+	{
+		return func( instance, pCreateInfo, pAllocator, pDebugMessenger );
+	}
+	else
+	{
+		return VK_ERROR_EXTENSION_NOT_PRESENT;
+	}
+}
+
+inline void DestroyDebugUtilsMessengerEXT(
+	VkInstance instance,
+	VkDebugUtilsMessengerEXT debugMessenger,
+	const VkAllocationCallbacks *pAllocator)
+{
+	auto func = (PFN_vkDestroyDebugUtilsMessengerEXT) vkGetInstanceProcAddr( instance, "vkDestroyDebugUtilsMessengerEXT" );
+	
+	if ( func != nullptr )
+	{
+		func( instance, debugMessenger, pAllocator );
+	}
+}
+
+struct QueueFamilyIndices
+{
+	std::optional<uint32_t> graphicsFamily;
+	std::optional<uint32_t> presentFamily;
+
+	// Dedicated families when the device has them, otherwise the graphics family
+	std::optional<uint32_t> computeFamily;
+	std::optional<uint32_t> transferFamily;
+
+	// Headless rendering has no surface, so only a graphics family is needed
+	bool isComplete( bool requirePresent = true ) const
+	{
+		return graphicsFamily.has_value() && ( !requirePresent || presentFamily.has_value() );
+	}
+};
+
+struct SwapChainSupportDetails
+{
+	VkSurfaceCapabilitiesKHR capabilities;
+	std::vector<VkSurfaceFormatKHR> formats;
+	std::vector<VkPresentModeKHR> presentModes;
+};
+
+// Interleaved so a vertex is fetched with a single 12 byte read. The colour is
+// packed RGBA8 and expanded to a normalized vec4 by the input assembler.
+struct Vertex
+{
+	float pos[2];
+	uint32_t color;
+
+	static VkVertexInputBindingDescription getBindingDescription()
+	{
+		VkVertexInputBindingDescription bindingDescription = {};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = sizeof( Vertex );
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
+
+	static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions()
+	{
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions( 2 );
+
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+		attributeDescriptions[0].offset = offsetof( Vertex, pos );
+
+		attributeDescriptions[1].binding = 0;
+		attributeDescriptions[1].location = 1;
+		attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+		attributeDescriptions[1].offset = offsetof( Vertex, color );
+
+		return attributeDescriptions;
+	}
+};
+
+// Colours are stored as little-endian RGBA8, so red is the low byte
+const uint32_t TRIANGLE_COLORS[3] = { 0xff0000ff, 0xff00ff00, 0xffff0000 };
+
+// Lays out triangleCount copies of the original triangle on a grid covering the
+// viewport. A count of 1 gives exactly the original triangle.
+inline void generateTriangleGrid( uint32_t triangleCount, std::vector<Vertex> &vertices, std::vector<uint32_t> &indices )
+{
+	uint32_t columns = static_cast<uint32_t>( std::ceil( std::sqrt( static_cast<double>(triangleCount) ) ) );
+	uint32_t rows = ( triangleCount + columns - 1 ) / columns;
+
+	float cellWidth = 2.0f / columns;
+	float cellHeight = 2.0f / rows;
+
+	vertices.clear();
+	indices.clear();
+	vertices.reserve( triangleCount * 3 );
+	indices.reserve( triangleCount * 3 );
+
+	for ( uint32_t i = 0; i < triangleCount; i++ )
+	{
+		float centerX = -1.0f + cellWidth * ( i % columns + 0.5f );
+		float centerY = -1.0f + cellHeight * ( i / columns + 0.5f );
+		float halfWidth = cellWidth * 0.25f;
+		float halfHeight = cellHeight * 0.25f;
+
+		uint32_t first = static_cast<uint32_t>(vertices.size());
+		vertices.push_back( { { centerX, centerY - halfHeight }, TRIANGLE_COLORS[0] } );
+		vertices.push_back( { { centerX + halfWidth, centerY + halfHeight }, TRIANGLE_COLORS[1] } );
+		vertices.push_back( { { centerX - halfWidth, centerY + halfHeight }, TRIANGLE_COLORS[2] } );
+
+		indices.push_back( first );
+		indices.push_back( first + 1 );
+		indices.push_back( first + 2 );
+	}
+}
+
+// Per-object data, read from a storage buffer by the vertex shader and by the
+// culling pass. Matches the std430 layout of Instance in the shaders.
+struct InstanceData
+{
+	float offset[2];
+	float scale;
+	uint32_t variant;	// pipeline variant group, filled in by the renderer
+};
+
+// Places objectCount copies of the mesh on a grid covering the viewport. A
+// count of 1 leaves the mesh where it is.
+inline void generateObjectGrid( uint32_t objectCount, std::vector<InstanceData> &instances )
+{
+	uint32_t columns = static_cast<uint32_t>( std::ceil( std::sqrt( static_cast<double>(objectCount) ) ) );
+	uint32_t rows = ( objectCount + columns - 1 ) / columns;
+
+	float cellWidth = 2.0f / columns;
+	float cellHeight = 2.0f / rows;
+
+	instances.resize( objectCount );
+	for ( uint32_t i = 0; i < objectCount; i++ )
+	{
+		instances[i].offset[0] = objectCount == 1 ? 0.0f : -1.0f + cellWidth * ( i % columns + 0.5f );
+		instances[i].offset[1] = objectCount == 1 ? 0.0f : -1.0f + cellHeight * ( i / columns + 0.5f );
+		instances[i].scale = std::min( cellWidth, cellHeight ) * 0.5f;
+		instances[i].variant = 0;
+	}
+}
+
+// 2D camera applied by the vertex shader, clip = ( world - offset ) * zoom.
+// Matches the push constant block in shader.vert.
+struct CameraData
+{
+	float offset[2];
+	float zoom;
+};
+
+// Fragment stage push constants with bindless textures, following CameraData
+struct DrawConstants
+{
+	uint32_t textureIndex;
+};
+
+// Push constants of cull.comp. An object is visible when, for every plane,
+// dot( plane.xyz, center ) + plane.w >= -radius.
+struct CullingParameters
+{
+	float planes[4][4];
+	uint32_t objectCount;
+
+	// How far, in mesh units, objects move away from their offset
+	float motionRadius;
+};
+
+// Per-frame uniforms of shader.vert, std140. Written once per frame into the
+// frame slot's region of the uniform ring.
+struct FrameUniforms
+{
+	float time;
+	float motionAmplitude;
+	float padding[2];
+};
+
+// The left, right, bottom and top planes of the region the camera sees. Near
+// and far do not exist in 2D.
+inline void computeFrustumPlanes( const CameraData &camera, float planes[4][4] )
+{
+	const float normals[4][2] = { { 1.0f, 0.0f }, { -1.0f, 0.0f }, { 0.0f, 1.0f }, { 0.0f, -1.0f } };
+	float halfExtent = 1.0f / camera.zoom;
+
+	for ( int i = 0; i < 4; i++ )
+	{
+		planes[i][0] = normals[i][0];
+		planes[i][1] = normals[i][1];
+		planes[i][2] = 0.0f;
+		planes[i][3] = halfExtent - ( normals[i][0] * camera.offset[0] + normals[i][1] * camera.offset[1] );
+	}
+}
+
+// Extent-dependent objects of a swap chain that has been replaced. They are
+// destroyed once every frame submitted before the replacement has completed,
+// which avoids a vkDeviceWaitIdle on every resize.
+struct RetiredSwapChain
+{
+	VkSwapchainKHR swapChain;
+	std::vector<VkImageView> imageViews;
+	std::vector<VkFramebuffer> framebuffers;
+	TransientImageSet transientImages;
+	uint64_t retiredAtFrame;
+};
+
+// How the objects of the scene are submitted. All three render the same image,
+// objects sharing a pipeline variant are always contiguous instances.
+enum class DrawMode
+{
+	Direct,		// one vkCmdDrawIndexed per object
+	Instanced,	// one instanced vkCmdDrawIndexed per pipeline variant
+	Indirect	// one vkCmdDrawIndexedIndirect per pipeline variant, parameters read from a GPU buffer
+};
+
+inline const char *drawModeName( DrawMode drawMode )
+{
+	switch ( drawMode )
+	{
+	case DrawMode::Direct:    return "direct";
+	case DrawMode::Instanced: return "instanced";
+	case DrawMode::Indirect:  return "indirect";
+	default:                  return "unknown";
+	}
+}
+
+inline bool parseDrawMode( const std::string &name, DrawMode &drawMode )
+{
+	for ( auto mode : { DrawMode::Direct, DrawMode::Instanced, DrawMode::Indirect } )
+	{
+		if ( name == drawModeName( mode ) )
+		{
+			drawMode = mode;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Numeric command line arguments. Unlike std::stoul and std::stof, which
+// throw on garbage and ignore trailing text, the whole argument has to parse.
+inline bool parseUint32( const std::string &text, uint32_t &value )
+{
+	if ( text.empty() || !std::isdigit( static_cast<unsigned char>(text[0]) ) )
+	{
+		return false;
+	}
+
+	char *end = nullptr;
+	errno = 0;
+	unsigned long long parsed = std::strtoull( text.c_str(), &end, 10 );
+	if ( errno != 0 || *end != '\0' || parsed > UINT32_MAX )
+	{
+		return false;
+	}
+	value = static_cast<uint32_t>(parsed);
+	return true;
+}
+
+inline bool parseFloat( const std::string &text, float &value )
+{
+	char *end = nullptr;
+	errno = 0;
+	float parsed = std::strtof( text.c_str(), &end );
+	if ( text.empty() || errno != 0 || *end != '\0' || !std::isfinite( parsed ) )
+	{
+		return false;
+	}
+	value = parsed;
+	return true;
+}
+
+struct ApplicationConfig
+{
+	// Render into app-owned images without a window, surface or swap chain
+	bool headless = false;
+
+	// Number of frames to render before exiting, 0 runs until the window is closed
+	uint32_t frameCount = 0;
+
+	// Per-frame CPU spans and GPU timestamps, reported periodically
+	bool profile = false;
+
+	// When set, every profiled frame is also written to this CSV file
+	std::string profileCsvPath;
+
+	// Objects in the scene, each drawn as its own draw call in DrawMode::Direct
+	uint32_t drawCount = 1;
+
+	// How the objects are submitted, see DrawMode
+	DrawMode drawMode = DrawMode::Direct;
+
+	// Cull objects against the camera in a compute pass and draw the survivors
+	// indirectly, implies DrawMode::Indirect
+	bool gpuCulling = false;
+
+	// Use dedicated compute and transfer queue families when the device has
+	// them, so culling and uploads run alongside rendering
+	bool dedicatedQueues = true;
+
+	// Route the driver's host allocations through HostAllocator and report
+	// them per allocation scope
+	bool trackHostAllocations = false;
+
+	// Reuse device capabilities probed by earlier runs with the same driver,
+	// see CapabilityCache
+	bool capabilityCache = false;
+
+	// Device to render on, by enumeration index, UUID or part of its name.
+	// Falls back to VKI_DEVICE, and without either to the best scoring device.
+	std::string deviceSelector;
+
+	// Validation messages at least this severe, and of these types, are logged
+	// in debug builds. Performance warnings are counted whatever the filter.
+	VkDebugUtilsMessageSeverityFlagBitsEXT debugSeverity = DEFAULT_DEBUG_SEVERITY;
+	VkDebugUtilsMessageTypeFlagsEXT debugTypes = ALL_DEBUG_MESSAGE_TYPES;
+
+	// Camera zoom. Above 1 the zoomed-in view pans around the scene, leaving
+	// most objects off screen.
+	float cameraZoom = 1.0f;
+
+	// Worker threads recording secondary command buffers, 0 records inline on the main thread
+	uint32_t recordThreads = 0;
+
+	// Time single- versus multi-threaded recording of one frame and exit
+	bool recordBenchmark = false;
+
+	// Frames the CPU may queue ahead of the GPU, independent of the swap chain image count
+	uint32_t framesInFlight = 2;
+
+	// Let the renderer raise or lower framesInFlight based on CPU time blocked on fences
+	bool adaptiveFramesInFlight = false;
+
+	// Pace frames with per-slot fences even when timeline semaphores are available
+	bool forceFences = false;
+
+	// Distinct pipeline variants, each drawing an equal share of the objects, compiled in the background
+	uint32_t pipelineVariants = 1;
+
+	// Background pipeline compile threads, 0 picks one per two hardware threads
+	uint32_t pipelineThreads = 0;
+
+	// Window or offscreen render target size
+	uint32_t width = WIDTH;
+	uint32_t height = HEIGHT;
+
+	// Triangles in the mesh drawn by every draw call
+	uint32_t triangleCount = 1;
+
+	// Rewrite the mesh's vertices every frame and stream them to the GPU
+	// through the upload ring
+	bool streamVertices = false;
+
+	// Size of the persistently mapped staging ring shared by all frames in flight
+	uint32_t uploadRingMiB = 16;
+
+	// PPM or TGA images applied to the mesh, one at a time, switching every
+	// textureSwitchFrames frames. Without any the mesh shows its vertex colours.
+	std::vector<std::string> texturePaths;
+	uint32_t textureSwitchFrames = 120;
+
+	// Resident memory above which unreferenced textures are evicted, least recently used first
+	uint32_t textureBudgetMiB = 256;
+
+	// Index textures out of one update-after-bind descriptor array when the
+	// device supports descriptor indexing, instead of rewriting per-frame sets
+	bool bindlessTextures = true;
+
+	// Radius, in mesh units, of the circle each object travels around its
+	// offset, driven by the per-frame uniforms. 0 keeps every object still.
+	float objectMotion = 0.0f;
+
+	// Samples per pixel, clamped to what the device supports for both colour
+	// and depth. Above 1 the frame is rendered to a multisampled target and
+	// resolved into the swap chain image at the end of the render pass.
+	uint32_t msaaSamples = 1;
+
+	// Let render graph images whose lifetimes do not overlap share memory,
+	// see TransientAllocator
+	bool transientAliasing = true;
+
+	// Requested present mode, mailbox with a FIFO fallback when unset
+	std::optional<VkPresentModeKHR> presentMode;
+};
+
+inline const char *presentModeName( VkPresentModeKHR presentMode )
+{
+	switch ( presentMode )
+	{
+	case VK_PRESENT_MODE_IMMEDIATE_KHR:    return "immediate";
+	case VK_PRESENT_MODE_MAILBOX_KHR:      return "mailbox";
+	case VK_PRESENT_MODE_FIFO_KHR:         return "fifo";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo_relaxed";
+	default:                               return "unknown";
+	}
+}
+
+inline bool parsePresentMode( const std::string &name, VkPresentModeKHR &presentMode )
+{
+	const VkPresentModeKHR modes[ ] = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR };
+	for ( auto mode : modes )
+	{
+		if ( name == presentModeName( mode ) )
+		{
+			presentMode = mode;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Collected by every run, for the benchmark executable
+struct RunStatistics
+{
+	uint32_t frames = 0;
+	double elapsedMs = 0.0;
+	std::vector<double> frameMs;
+	double recordMs = 0.0;	// CPU time spent recording command buffers
+	double meanVisibleObjects = 0.0;	// objects drawn per frame, fewer than drawCount when culled
+	double uploadBytesPerFrame = 0.0;	// streamed through the upload ring
+	double uploadStallMs = 0.0;	// CPU time blocked on a full upload ring
+	uint32_t msaaSamples = 1;
+	double attachmentMiB = 0.0;	// depth and multisampled colour targets, as aliased
+	double attachmentUnaliasedMiB = 0.0;	// the same targets in memory of their own
+	double performanceWarningsPerFrame = 0.0;	// from the validation layers, debug builds only
+	double startupMs = 0.0;	// run() to the first presented frame
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	std::string deviceName;
+};
+
+// Per-thread recording state. Each worker owns one transient command pool per
+// frame in flight, reset wholesale once that frame has completed.
+struct RecordingWorker
+{
+	std::vector<VkCommandPool> commandPools;
+	std::vector<VkCommandBuffer> commandBuffers;
+};
+
+// A copy from a staging buffer into a device-local buffer, see uploadBuffers().
+// ownerFamily is the queue family that uses the buffer afterwards, or
+// VK_QUEUE_FAMILY_IGNORED for buffers shared by every family.
+struct BufferUpload
+{
+	VkBuffer source;
+	VkDeviceSize sourceOffset;
+	VkBuffer destination;
+	VkDeviceSize size;
+	uint32_t ownerFamily;
+};
+
+// Per-frame GPU culling output. cull.comp fills drawCommands and the compacted
+// visibleObjects list, which the graphics pass then consumes. The commands are
+// copied to readback after the frame, for the visible object counters.
+struct CullingFrame
+{
+	GpuBuffer drawCommands;
+	GpuBuffer visibleObjects;
+	GpuBuffer readback;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	bool readbackPending = false;
+};
+
+// -------------------------------------------------------------------------------------------------------------------------
+class HelloTriangleApplication
+{
+public:
+	explicit HelloTriangleApplication( const ApplicationConfig &config = ApplicationConfig() )
+		: config( config )
+	{
+	}
+
+	void run()
+	{
+		startupTimer.start();
+
+		// Instance capabilities need no window, probe them while GLFW starts up
+		instanceProbe = std::async( std::launch::async, probeInstanceCapabilities );
+		if ( !config.headless )
+		{
+			initWindow();
+		}
+		initVulkan();
+		mainLoop();
+		cleanup();
+	}
+
+	const RunStatistics &getRunStatistics() const
+	{
+		return runStatistics;
+	}
+
+private:
+	ApplicationConfig config;
+	RunStatistics runStatistics;
+
+	GLFWwindow *window;
+	VkInstance instance;
+	uint32_t instanceApiVersion = VK_API_VERSION_1_0;
+	VkDebugUtilsMessengerEXT debugMessenger;
+
+	// Queues validation messages for a logging thread, see setupDebugMessenger()
+	DebugMessageLog debugMessages;
+	VkSurfaceKHR surface;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice logicalDevice;
+	QueueFamilyIndices selectedQueueFamilies;
+
+	// Probed once at startup, see pickPhysicalDevice(). Formats and present
+	// modes do not change with the window, the surface capabilities do.
+	std::future<InstanceCapabilities> instanceProbe;
+	InstanceCapabilities instanceCapabilities;
+	DeviceCapabilities deviceCapabilities;
+	SwapChainSupportDetails surfaceSupport;
+	CapabilityCache capabilityCache;
+	StartupTimer startupTimer;
+	std::vector<uint32_t> uniqueQueueFamilies;
+	VkQueue graphicsQueue;
+	VkQueue presentQueue;
+	VkQueue computeQueue;
+	VkQueue transferQueue;
+	VkSwapchainKHR swapChain;
+	std::vector<VkImage> swapChainImages;
+	VkFormat swapChainImageFormat;
+	VkExtent2D swapChainExtent;
+	std::vector<VkImageView> swapChainImageViews;
+	std::vector<VkFramebuffer> swapChainFramebuffers;
+	std::vector<RetiredSwapChain> retiredSwapChains;
+
+	// Resize tracking, used to report how long a resize takes to reach the screen
+	bool framebufferResized = false;
+	bool resizePending = false;
+	bool awaitingFirstFrameAfterResize = false;
+	std::chrono::steady_clock::time_point resizeStartTime;
+	double swapChainRebuildMs = 0.0;
+
+	// Depth and, with MSAA, multisampled colour targets shared by every frame.
+	// The render graph orders each frame's use after the previous frame's.
+	VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+	VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+	TransientAllocator transientAllocator;
+	TransientImageSet transientImages;
+
+	// Headless render targets, used in place of swapChainImages
+	std::vector<VkImage> offscreenImages;
+	std::vector<GpuAllocation> offscreenImagesMemory;
+	uint32_t nextOffscreenImage = 0;
+	
+	VkRenderPass renderPass;	// the scene pass's, owned by renderGraph
+
+	// The frame's passes and the images they use, see createRenderGraph()
+	RenderGraph renderGraph;
+	uint32_t presentTarget = RenderGraph::NONE;
+	uint32_t depthTarget = RenderGraph::NONE;
+	uint32_t multisampledTarget = RenderGraph::NONE;
+	uint32_t scenePass = RenderGraph::NONE;
+
+	// What the scene pass records, set by recordCommandBuffer()
+	size_t recordingFrameSlot = 0;
+	std::vector<VkCommandBuffer> frameSecondaryCommandBuffers;
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkDescriptorPool descriptorPool;
+	std::vector<VkDescriptorSet> descriptorSets;
+	VkPipelineLayout pipelineLayout;
+	ShaderModuleCache shaderModules;
+
+	// The default pipeline is built before the first frame and stands in for
+	// every variant still compiling in the registry
+	VkPipeline graphicsPipeline;
+	PipelineRegistry pipelineRegistry;
+	std::vector<PipelineStateDesc> pipelineVariants;
+	std::vector<VkPipeline> drawPipelines;
+	std::chrono::steady_clock::time_point pipelineVariantsRequested;
+	bool pipelineVariantsPending = false;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	bool pipelineCacheLoaded = false;
+	
+	VkCommandPool commandPool;
+	VkCommandPool computeCommandPool;
+	VkCommandPool transferCommandPool;
+
+	GpuAllocator gpuAllocator;
+
+	// Receives the driver's host allocations when trackHostAllocations is set
+	HostAllocator hostAllocator;
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	GpuBuffer vertexBuffer;
+	GpuBuffer indexBuffer;
+
+	// Per-frame uploads are written straight into the upload ring and copied
+	// out of it by the frame's own command buffer, or on a dedicated transfer
+	// queue in a command buffer submitted just ahead of it. Streamed vertices
+	// land in a pooled buffer, bound in place of vertexBuffer.
+	UploadRing uploadRing;
+	BufferPool streamBufferPool;
+	GpuBuffer frameVertexBuffer;
+	bool asyncTransfer = false;
+	std::vector<VkCommandBuffer> transferCommandBuffers;
+	std::vector<VkSemaphore> uploadCompleteSemaphores;
+	VkPipelineStageFlags uploadWaitStages = UPLOAD_CONSUMER_STAGES;
+	bool uploadSubmissionPending = false;
+
+	// Per-frame shader inputs, one aligned region per frame slot bound with a
+	// dynamic offset
+	UniformRing uniformRing;
+
+	// The texture on screen stays until the next one in texturePaths is ready.
+	// Each frame slot's descriptor set is rewritten when its texture changes.
+	TextureCache textureCache;
+	VkSampler textureSampler = VK_NULL_HANDLE;
+	TextureCache::TextureId displayedTexture = TextureCache::INVALID_TEXTURE;
+	TextureCache::TextureId requestedTexture = TextureCache::INVALID_TEXTURE;
+	size_t nextTexturePath = 0;
+	std::vector<VkImageView> descriptorTextureViews;
+	uint64_t descriptorTextureEvictions = 0;
+
+	// With descriptor indexing the fragment shader picks the texture out of
+	// bindlessDescriptors by frameTextureIndex, pushed with every draw, and
+	// descriptorTextureViews is unused
+	bool bindlessTextures = false;
+	BindlessDescriptors bindlessDescriptors;
+	uint32_t frameTextureIndex = 0;
+
+	// Scene objects. In DrawMode::Indirect the draw parameters of every pipeline
+	// variant's group of objects live in indirectBuffer. The vertex shader finds
+	// an instance's object through a list of object indices, which is the
+	// identity in objectIndexBuffer unless the objects are culled.
+	DrawMode drawMode = DrawMode::Direct;
+	std::vector<InstanceData> instances;
+	GpuBuffer instanceBuffer;
+	GpuBuffer indirectBuffer;
+	GpuBuffer objectIndexBuffer;
+	CameraData frameCamera = {};
+
+	// With GPU culling indirectBuffer holds zero instance counts and is copied
+	// over the frame's draw commands before cull.comp runs
+	bool gpuCulling = false;
+	VkDescriptorSetLayout cullingSetLayout;
+	VkPipelineLayout cullingPipelineLayout;
+	VkPipeline cullingPipeline;
+	std::vector<CullingFrame> cullingFrames;
+
+	// On a dedicated compute queue the culling pass is submitted on its own
+	// and hands its output over to the graphics queue through a semaphore
+	bool asyncCompute = false;
+	std::vector<VkCommandBuffer> computeCommandBuffers;
+	std::vector<VkSemaphore> cullingCompleteSemaphores;
+	uint64_t culledFrameCount = 0;
+	uint64_t visibleObjectTotal = 0;
+
+	// One primary command buffer per frame in flight, re-recorded every frame
+	std::vector<VkCommandBuffer> commandBuffers;
+	std::unique_ptr<WorkerPool> recordingPool;
+	std::vector<RecordingWorker> recordingWorkers;
+
+	std::vector<VkSemaphore> imageAvailableSemaphores;
+	std::vector<VkSemaphore> renderFinishedSemaphores;
+
+	// Frame completion is tracked by frame number. With timeline semaphores the
+	// graphics queue's counter reaches frameNumber + 1 once that frame is done.
+	// Otherwise each frame slot has a binary fence.
+	bool useTimelineSemaphores = false;
+	TimelineSemaphoreFunctions timelineFunctions;
+	TimelineSemaphore graphicsTimeline;
+	std::vector<VkFence> inFlightFences;
+
+	// Last frame submitted from each slot and last frame rendered to each image,
+	// UINT64_MAX when there is none
+	std::vector<uint64_t> frameSlotFrames;
+	std::vector<uint64_t> imageFrames;
+	size_t currentFrame = 0;
+	uint64_t frameNumber = 0;
+
+	// Per-frame resources exist for frameSlotCount slots, of which the first
+	// framePacer.depth() are in use
+	uint32_t frameSlotCount = 0;
+	FramePacer framePacer;
+
+	// When the frame occupying each slot sampled its input, for latency tracking
+	std::vector<std::optional<std::chrono::steady_clock::time_point>> frameSlotStartTimes;
+	std::chrono::steady_clock::time_point frameStartTime;
+	std::chrono::steady_clock::time_point previousFrameStartTime;
+	double frameBlockedMs = 0.0;
+
+	FrameProfiler profiler;
+
+	// One two-entry timestamp query pool per frame in flight, written around the
+	// render graph's passes. The results are read once the frame that last used the slot
+	// has completed.
+	bool gpuTimestampsEnabled = false;
+	double timestampPeriod = 1.0;
+	uint64_t timestampMask = UINT64_MAX;
+	std::vector<VkQueryPool> timestampQueryPools;
+	std::vector<uint64_t> timestampPendingFrames;
+
+	void initWindow()
+	{
+		glfwInit();
+		startupTimer.mark( "glfwInit" );
+
+		glfwWindowHint( GLFW_CLIENT_API, GLFW_NO_API );
+		glfwWindowHint( GLFW_RESIZABLE, GLFW_TRUE );
+		
+		window = glfwCreateWindow( config.width, config.height, "Vulkan", nullptr, nullptr );
+		glfwSetWindowUserPointer( window, this );
+		glfwSetFramebufferSizeCallback( window, framebufferResizeCallback );
+		startupTimer.mark( "window" );
+	}
+
+	static void framebufferResizeCallback( GLFWwindow *window, int width, int height )
+	{
+		auto app = reinterpret_cast<HelloTriangleApplication *>( glfwGetWindowUserPointer( window ) );
+		app->framebufferResized = true;
+
+		// Latency is measured from the first event of a burst of resizes
+		if ( !app->resizePending )
+		{
+			app->resizePending = true;
+			app->resizeStartTime = std::chrono::steady_clock::now();
+		}
+	}
+
+	void initVulkan() 
+	{
+		if ( config.trackHostAllocations )
+		{
+			vulkanHostAllocator = hostAllocator.get();
+		}
+		if ( enableValidationLayers )
+		{
+			debugMessages.start( config.debugSeverity, config.debugTypes );
+		}
+		instanceCapabilities = instanceProbe.get();
+		startupTimer.mark( "instance probe" );
+		createInstance();
+		setupDebugMessenger();
+		startupTimer.mark( "instance" );
+		if ( !config.headless )
+		{
+			createSurface();
+			startupTimer.mark( "surface" );
+		}
+		pickPhysicalDevice();
+		startupTimer.mark( "device selection" );
+		createLogicalDevice();
+		startupTimer.mark( "logical device" );
+		configureFramesInFlight();
+		gpuAllocator.init( physicalDevice, logicalDevice );
+		transientAllocator.init( logicalDevice, gpuAllocator, config.transientAliasing );
+		shaderModules.init( logicalDevice );
+		createPipelineCache();
+		uploadRing.init( logicalDevice, gpuAllocator, static_cast<VkDeviceSize>(config.uploadRingMiB) * 1024 * 1024 );
+		streamBufferPool.init( logicalDevice, gpuAllocator );
+		createUniformRing();
+		if ( bindlessTextures )
+		{
+			bindlessDescriptors.init( logicalDevice, BINDLESS_TEXTURE_CAPACITY );
+		}
+		textureCache.init( physicalDevice, logicalDevice, gpuAllocator, uploadRing, bindlessTextures ? &bindlessDescriptors : nullptr,
+			static_cast<VkDeviceSize>(config.textureBudgetMiB) * 1024 * 1024, 2 );
+		startupTimer.mark( "allocators" );
+		if ( config.headless )
+		{
+			createOffscreenImages();
+		}
+		else
+		{
+			createSwapChain();
+		}
+		createImageViews();
+		startupTimer.mark( "swap chain" );
+		chooseAttachmentFormats();
+		createRenderGraph();
+		createDescriptorSetLayout();
+		createGraphicsPipeline();
+		if ( gpuCulling )
+		{
+			createCullingPipeline();
+		}
+		startupTimer.mark( "pipelines" );
+		createAttachments();
+		createFrameBuffers();
+		createCommandPool();
+		createMeshBuffers();
+		frameVertexBuffer = vertexBuffer;
+		createInstanceBuffers();
+		if ( gpuCulling )
+		{
+			createCullingFrames();
+		}
+		createDescriptorSets();
+		createCommandBuffers();
+		createRecordingWorkers( config.recordThreads );
+		createTimestampQueries();
+		createSyncObjects();
+		startupTimer.mark( "resources" );
+	}
+	void mainLoop()
+	{
+		if ( config.recordBenchmark )
+		{
+			runRecordingBenchmark();
+			return;
+		}
+
+		if ( config.profile )
+		{
+			profiler.enable( 1000, frameSlotCount + 1, 2.0 );
+			if ( !config.profileCsvPath.empty() )
+			{
+				profiler.openCsv( config.profileCsvPath );
+			}
+		}
+
+		uint32_t frameCount = config.frameCount;
+		if ( config.headless && frameCount == 0 )
+		{
+			frameCount = HEADLESS_DEFAULT_FRAME_COUNT;
+		}
+
+		auto startTime = std::chrono::steady_clock::now();
+		uint32_t framesRendered = 0;
+
+		while ( frameCount == 0 || framesRendered < frameCount )
+		{
+			if ( !config.headless )
+			{
+				if ( glfwWindowShouldClose( window ) )
+				{
+					break;
+				}
+				glfwPollEvents();
+			}
+
+			drawFrame();
+			framesRendered++;
+
+			profiler.reportPeriodically( std::cout );
+		}
+
+		vkDeviceWaitIdle( logicalDevice );
+		destroyRetiredSwapChains( true );
+
+		framePacer.report( std::cout );
+		if ( pipelineVariants.size() > 1 )
+		{
+			pipelineRegistry.report( std::cout );
+		}
+		shaderModules.report( std::cout );
+		transientAllocator.report( std::cout, transientImages, renderGraph );
+		renderGraph.report( std::cout );
+		reportCulling();
+		if ( config.trackHostAllocations )
+		{
+			hostAllocator.report( std::cout );
+		}
+		if ( enableValidationLayers )
+		{
+			debugMessages.report( std::cout );
+			runStatistics.performanceWarningsPerFrame = frameNumber > 0 ? static_cast<double>(debugMessages.performanceMessageCount()) / frameNumber : 0.0;
+		}
+		if ( config.streamVertices )
+		{
+			uploadRing.report( std::cout );
+			streamBufferPool.report( std::cout );
+		}
+		if ( config.objectMotion > 0.0f )
+		{
+			uniformRing.report( std::cout );
+		}
+		if ( !config.texturePaths.empty() )
+		{
+			textureCache.report( std::cout );
+			if ( bindlessTextures )
+			{
+				bindlessDescriptors.report( std::cout );
+			}
+		}
+		runStatistics.uploadBytesPerFrame = uploadRing.meanFrameBytes();
+		runStatistics.uploadStallMs = uploadRing.totalStallMs();
+
+		if ( profiler.isEnabled() )
+		{
+			// Pick up the timestamps of the frames that were still in flight
+			for ( size_t i = 0; i < timestampPendingFrames.size(); i++ )
+			{
+				collectGpuTimestamps( i );
+			}
+
+			profiler.report( std::cout );
+			profiler.finish();
+		}
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+		runStatistics.frames = framesRendered;
+		runStatistics.elapsedMs = elapsed.count();
+
+		// Without a compositor or vsync this is the raw throughput of the renderer
+		if ( config.headless )
+		{
+			std::cout << "Rendered " << framesRendered << " frames in " << elapsed.count() << " ms ("
+				<< ( framesRendered * 1000.0 / elapsed.count() ) << " frames/s, "
+				<< ( elapsed.count() / framesRendered ) << " ms/frame)" << std::endl;
+		}
+	}
+
+	void cleanup()
+	{
+		for ( auto queryPool : timestampQueryPools )
+		{
+			vkDestroyQueryPool( logicalDevice, queryPool, vulkanHostAllocator );
+		}
+
+		for ( size_t i = 0; i < frameSlotCount; i++ )
+		{
+			vkDestroySemaphore( logicalDevice, renderFinishedSemaphores[i], vulkanHostAllocator );
+			vkDestroySemaphore( logicalDevice, imageAvailableSemaphores[i], vulkanHostAllocator );
+		}
+
+		for ( auto semaphore : cullingCompleteSemaphores )
+		{
+			vkDestroySemaphore( logicalDevice, semaphore, vulkanHostAllocator );
+		}
+
+		for ( auto semaphore : uploadCompleteSemaphores )
+		{
+			vkDestroySemaphore( logicalDevice, semaphore, vulkanHostAllocator );
+		}
+
+		for ( auto fence : inFlightFences )
+		{
+			vkDestroyFence( logicalDevice, fence, vulkanHostAllocator );
+		}
+		graphicsTimeline.destroy();
+
+		destroyRecordingWorkers();
+		vkDestroyCommandPool( logicalDevice, transferCommandPool, vulkanHostAllocator );
+		vkDestroyCommandPool( logicalDevice, computeCommandPool, vulkanHostAllocator );
+		vkDestroyCommandPool( logicalDevice, commandPool, vulkanHostAllocator );
+
+		for ( auto &frame : cullingFrames )
+		{
+			destroyBuffer( frame.readback );
+			destroyBuffer( frame.visibleObjects );
+			destroyBuffer( frame.drawCommands );
+		}
+		if ( objectIndexBuffer.buffer != VK_NULL_HANDLE )
+		{
+			destroyBuffer( objectIndexBuffer );
+		}
+		if ( indirectBuffer.buffer != VK_NULL_HANDLE )
+		{
+			destroyBuffer( indirectBuffer );
+		}
+		destroyBuffer( instanceBuffer );
+		destroyBuffer( indexBuffer );
+		destroyBuffer( vertexBuffer );
+		textureCache.destroy();
+		bindlessDescriptors.destroy();
+		streamBufferPool.destroy();
+		uniformRing.destroy();
+		uploadRing.destroy();
+		vkDestroyDescriptorPool( logicalDevice, descriptorPool, vulkanHostAllocator );
+
+		for ( auto framebuffer : swapChainFramebuffers )
+		{
+			vkDestroyFramebuffer( logicalDevice, framebuffer, vulkanHostAllocator );
+		}
+		transientAllocator.destroy( transientImages );
+
+		pipelineRegistry.destroy();
+		vkDestroyPipelineLayout( logicalDevice, pipelineLayout, vulkanHostAllocator );
+		vkDestroyDescriptorSetLayout( logicalDevice, descriptorSetLayout, vulkanHostAllocator );
+		if ( gpuCulling )
+		{
+			vkDestroyPipeline( logicalDevice, cullingPipeline, vulkanHostAllocator );
+			vkDestroyPipelineLayout( logicalDevice, cullingPipelineLayout, vulkanHostAllocator );
+			vkDestroyDescriptorSetLayout( logicalDevice, cullingSetLayout, vulkanHostAllocator );
+		}
+		shaderModules.destroy();
+
+		savePipelineCache();
+		vkDestroyPipelineCache( logicalDevice, pipelineCache, vulkanHostAllocator );
+		renderGraph.destroy();
+
+		for ( auto imageView : swapChainImageViews )
+		{
+			vkDestroyImageView( logicalDevice, imageView, vulkanHostAllocator );
+		}
+
+		if ( config.headless )
+		{
+			for ( size_t i = 0; i < offscreenImages.size(); i++ )
+			{
+				vkDestroyImage( logicalDevice, offscreenImages[i], vulkanHostAllocator );
+				gpuAllocator.free( offscreenImagesMemory[i] );
+			}
+		}
+		else
+		{
+			vkDestroySwapchainKHR( logicalDevice, swapChain, vulkanHostAllocator );
+		}
+
+		gpuAllocator.destroy();
+		vkDestroyDevice( logicalDevice, vulkanHostAllocator );
+
+		if ( enableValidationLayers )
+		{
+			DestroyDebugUtilsMessengerEXT( instance, debugMessenger, vulkanHostAllocator );
+		}
+		
+		if ( !config.headless )
+		{
+			vkDestroySurfaceKHR( instance, surface, vulkanHostAllocator );
+		}
+		vkDestroyInstance( instance, vulkanHostAllocator );
+		vulkanHostAllocator = nullptr;
+		hostAllocator.destroy();
+
+		// No more messages can arrive once the instance is gone
+		debugMessages.stop();
+
+		if ( !config.headless )
+		{
+			glfwDestroyWindow( window );
+
+			glfwTerminate();
+		}
+	}
+	
+	void createSyncObjects()
+	{
+		imageAvailableSemaphores.resize( frameSlotCount );
+		renderFinishedSemaphores.resize( frameSlotCount );
+		frameSlotFrames.assign( frameSlotCount, UINT64_MAX );
+		imageFrames.assign( swapChainFramebuffers.size(), UINT64_MAX );
+
+		VkSemaphoreCreateInfo semaphoreInfo = {};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		for (size_t i = 0; i < frameSlotCount; i++ )
+		{
+			if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, vulkanHostAllocator, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
+				 vkCreateSemaphore(logicalDevice, &semaphoreInfo, vulkanHostAllocator, &renderFinishedSemaphores[i]) != VK_SUCCESS)
+			{
+				throw std::runtime_error( "failed to create synchronization objects for a frame!" );
+			}
+		}
+
+		if ( asyncCompute )
+		{
+			cullingCompleteSemaphores.resize( frameSlotCount );
+			for ( auto &semaphore : cullingCompleteSemaphores )
+			{
+				if ( vkCreateSemaphore( logicalDevice, &semaphoreInfo, vulkanHostAllocator, &semaphore ) != VK_SUCCESS )
+				{
+					throw std::runtime_error( "failed to create synchronization objects for a frame!" );
+				}
+			}
+		}
+
+		if ( asyncTransfer )
+		{
+			uploadCompleteSemaphores.resize( frameSlotCount );
+			for ( auto &semaphore : uploadCompleteSemaphores )
+			{
+				if ( vkCreateSemaphore( logicalDevice, &semaphoreInfo, vulkanHostAllocator, &semaphore ) != VK_SUCCESS )
+				{
+					throw std::runtime_error( "failed to create synchronization objects for a frame!" );
+				}
+			}
+		}
+
+		if ( useTimelineSemaphores )
+		{
+			graphicsTimeline.create( logicalDevice, timelineFunctions );
+			return;
+		}
+
+		inFlightFences.resize( frameSlotCount );
+
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+		for (size_t i = 0; i < frameSlotCount; i++ )
+		{
+			if ( vkCreateFence( logicalDevice, &fenceInfo, vulkanHostAllocator, &inFlightFences[i] ) != VK_SUCCESS )
+			{
+				throw std::runtime_error( "failed to create synchronization objects for a frame!" );
+			}
+		}
+	}
+
+	bool isFrameComplete( uint64_t frame )
+	{
+		if ( frame == UINT64_MAX )
+		{
+			return true;
+		}
+
+		if ( useTimelineSemaphores )
+		{
+			return graphicsTimeline.isComplete( frame + 1 );
+		}
+
+		// A frame whose slot has since been reused was waited on before the reuse
+		for ( size_t i = 0; i < frameSlotFrames.size(); i++ )
+		{
+			if ( frameSlotFrames[i] == frame )
+			{
+				return vkGetFenceStatus( logicalDevice, inFlightFences[i] ) == VK_SUCCESS;
+			}
+		}
+		return frame < frameNumber;
+	}
+
+	void waitForFrame( uint64_t frame )
+	{
+		if ( frame == UINT64_MAX )
+		{
+			return;
+		}
+
+		if ( useTimelineSemaphores )
+		{
+			graphicsTimeline.wait( frame + 1 );
+			return;
+		}
+
+		for ( size_t i = 0; i < frameSlotFrames.size(); i++ )
+		{
+			if ( frameSlotFrames[i] == frame )
+			{
+				vkWaitForFences( logicalDevice, 1, &inFlightFences[i], VK_TRUE, UINT64_MAX );
+				return;
+			}
+		}
+	}
+
+	// Submits the current frame's work on the graphics queue and records which
+	// frame now occupies the frame slot and the image
+	void submitFrame( VkSubmitInfo &submitInfo, uint32_t imageIndex )
+	{
+		VkFence fence = VK_NULL_HANDLE;
+
+		// Uploads and the culling pass go first on their own queues, the
+		// graphics work waits for them only where their output is consumed
+		std::vector<VkSemaphore> waitSemaphores( submitInfo.pWaitSemaphores, submitInfo.pWaitSemaphores + submitInfo.waitSemaphoreCount );
+		std::vector<VkPipelineStageFlags> waitStages( submitInfo.pWaitDstStageMask, submitInfo.pWaitDstStageMask + submitInfo.waitSemaphoreCount );
+		if ( uploadSubmissionPending )
+		{
+			submitUploads();
+
+			waitSemaphores.push_back( uploadCompleteSemaphores[currentFrame] );
+			waitStages.push_back( uploadWaitStages );
+		}
+		if ( asyncCompute )
+		{
+			submitCulling();
+
+			waitSemaphores.push_back( cullingCompleteSemaphores[currentFrame] );
+			waitStages.push_back( CULLING_OUTPUT_STAGES );
+		}
+		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfo.pWaitSemaphores = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask = waitStages.data();
+
+		std::vector<VkSemaphore> signalSemaphores( submitInfo.pSignalSemaphores, submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount );
+		std::vector<uint64_t> signalValues( signalSemaphores.size(), 0 );
+		VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+
+		if ( useTimelineSemaphores )
+		{
+			uint64_t value = graphicsTimeline.nextValue();
+			if ( value != frameNumber + 1 )
+			{
+				throw std::runtime_error( "graphics timeline out of step with the frame number!" );
+			}
+
+			// Binary semaphores in the same batch ignore their value
+			signalSemaphores.push_back( graphicsTimeline.handle() );
+			signalValues.push_back( value );
+
+			timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+			timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+			timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+			submitInfo.pNext = &timelineInfo;
+			submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+			submitInfo.pSignalSemaphores = signalSemaphores.data();
+		}
+		else
+		{
+			fence = inFlightFences[currentFrame];
+			vkResetFences( logicalDevice, 1, &fence );
+		}
+
+		{
+			FrameProfiler::ScopedSpan span( profiler, CpuSpan::QueueSubmit );
+			if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence) != VK_SUCCESS )
+			{
+				throw std::runtime_error( "failed to submit draw command buffer!" );
+			}
+		}
+
+		frameSlotFrames[currentFrame] = frameNumber;
+		imageFrames[imageIndex] = frameNumber;
+	}
+	
+	void createCommandBuffers()
+	{
+		commandBuffers.resize( frameSlotCount );
+
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = (uint32_t) commandBuffers.size();
+
+		if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+		{
+			throw std::runtime_error( "failed to allocate command buffers!" );
+		}
+
+		if ( asyncCompute )
+		{
+			computeCommandBuffers.resize( frameSlotCount );
+			allocInfo.commandPool = computeCommandPool;
+
+			if ( vkAllocateCommandBuffers( logicalDevice, &allocInfo, computeCommandBuffers.data() ) != VK_SUCCESS )
+			{
+				throw std::runtime_error( "failed to allocate command buffers!" );
+			}
+		}
+
+		if ( asyncTransfer )
+		{
+			transferCommandBuffers.resize( frameSlotCount );
+			allocInfo.commandPool = transferCommandPool;
+
+			if ( vkAllocateCommandBuffers( logicalDevice, &allocInfo, transferCommandBuffers.data() ) != VK_SUCCESS )
+			{
+				throw std::runtime_error( "failed to allocate command buffers!" );
+			}
+		}
+	}
+
+	void createRecordingWorkers( uint32_t workerCount )
+	{
+		if ( workerCount == 0 )
+		{
+			return;
+		}
+
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = selectedQueueFamilies.graphicsFamily.value();
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		recordingWorkers.resize( workerCount );
+		for ( auto &worker : recordingWorkers )
+		{
+			worker.commandPools.resize( frameSlotCount );
+			worker.commandBuffers.resize( frameSlotCount );
+
+			for ( size_t i = 0; i < frameSlotCount; i++ )
+			{
+				if ( vkCreateCommandPool( logicalDevice, &poolInfo, vulkanHostAllocator, &worker.commandPools[i] ) != VK_SUCCESS )
+				{
+					throw std::runtime_error( "failed to create command pool!" );
+				}
+
+				VkCommandBufferAllocateInfo allocInfo = {};
+				allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+				allocInfo.commandPool = worker.commandPools[i];
+				allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+				allocInfo.commandBufferCount = 1;
+
+				if ( vkAllocateCommandBuffers( logicalDevice, &allocInfo, &worker.commandBuffers[i] ) != VK_SUCCESS )
+				{
+					throw std::runtime_error( "failed to allocate command buffers!" );
+				}
+			}
+		}
+
+		recordingPool = std::make_unique<WorkerPool>( workerCount );
+	}
+
+	void destroyRecordingWorkers()
+	{
+		recordingPool.reset();
+
+		for ( auto &worker : recordingWorkers )
+		{
+			for ( auto pool : worker.commandPools )
+			{
+				vkDestroyCommandPool( logicalDevice, pool, vulkanHostAllocator );
+			}
+		}
+		recordingWorkers.clear();
+	}
+
+	// Objects [groupFirstObject( v ), groupFirstObject( v + 1 )) are drawn with
+	// pipeline variant v
+	uint32_t groupFirstObject( size_t group ) const
+	{
+		return static_cast<uint32_t>( static_cast<uint64_t>(group) * config.drawCount / pipelineVariants.size() );
+	}
+
+	// Records the draws for objects [firstDraw, firstDraw + drawCount) of the
+	// scene. Used both inline in the primary command buffer and from the
+	// recording workers. Instanced and indirect draws cover a whole variant
+	// group and are recorded by whoever owns the group's first object.
+	void recordDraws( VkCommandBuffer commandBuffer, size_t frameSlot, uint32_t firstDraw, uint32_t drawCount )
+	{
+		// Viewport and scissor are dynamic so the pipeline survives a resize
+		VkViewport viewport = {};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = (float) swapChainExtent.width;
+		viewport.height = (float) swapChainExtent.height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport( commandBuffer, 0, 1, &viewport );
+
+		VkRect2D scissor = {};
+		scissor.offset = { 0, 0 };
+		scissor.extent = swapChainExtent;
+		vkCmdSetScissor( commandBuffer, 0, 1, &scissor );
+
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers( commandBuffer, 0, 1, &frameVertexBuffer.buffer, &offset );
+		vkCmdBindIndexBuffer( commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32 );
+		uint32_t uniformOffset = uniformRing.offset( frameSlot );
+		vkCmdBindDescriptorSets( commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[frameSlot], 1, &uniformOffset );
+		vkCmdPushConstants( commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof( CameraData ), &frameCamera );
+
+		if ( bindlessTextures )
+		{
+			VkDescriptorSet bindlessSet = bindlessDescriptors.set();
+			vkCmdBindDescriptorSets( commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &bindlessSet, 0, nullptr );
+
+			DrawConstants drawConstants = {};
+			drawConstants.textureIndex = frameTextureIndex;
+			vkCmdPushConstants( commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof( CameraData ), sizeof( DrawConstants ), &drawConstants );
+		}
+
+		VkBuffer drawCommandBuffer = gpuCulling ? cullingFrames[frameSlot].drawCommands.buffer : indirectBuffer.buffer;
+		uint32_t indexCount = static_cast<uint32_t>(indices.size());
+		uint32_t lastDraw = firstDraw + drawCount;
+
+		for ( size_t group = 0; group < drawPipelines.size(); group++ )
+		{
+			uint32_t groupFirst = groupFirstObject( group );
+			uint32_t groupEnd = groupFirstObject( group + 1 );
+
+			if ( drawMode == DrawMode::Direct )
+			{
+				uint32_t first = std::max( groupFirst, firstDraw );
+				uint32_t end = std::min( groupEnd, lastDraw );
+				if ( first >= end )
+				{
+					continue;
+				}
+
+				vkCmdBindPipeline( commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipelines[group] );
+
+				// The object index reaches the shader as gl_InstanceIndex
+				for ( uint32_t i = first; i < end; i++ )
+				{
+					vkCmdDrawIndexed( commandBuffer, indexCount, 1, 0, 0, i );
+				}
+				continue;
+			}
+
+			if ( groupFirst == groupEnd || groupFirst < firstDraw || groupFirst >= lastDraw )
+			{
+				continue;
+			}
+
+			vkCmdBindPipeline( commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipelines[group] );
+
+			if ( drawMode == DrawMode::Instanced )
+			{
+				vkCmdDrawIndexed( commandBuffer, indexCount, groupEnd - groupFirst, 0, 0, groupFirst );
+			}
+			else
+			{
+				vkCmdDrawIndexedIndirect( commandBuffer, drawCommandBuffer, group * sizeof( VkDrawIndexedIndirectCommand ),
+					1, sizeof( VkDrawIndexedIndirectCommand ) );
+			}
+		}
+	}
+
+	// Picks this frame's pipeline for every variant on the main thread, so the
+	// recording workers only read drawPipelines
+	void resolveDrawPipelines()
+	{
+		drawPipelines.resize( pipelineVariants.size() );
+		for ( size_t i = 0; i < pipelineVariants.size(); i++ )
+		{
+			drawPipelines[i] = pipelineRegistry.acquire( pipelineVariants[i] );
+		}
+
+		if ( pipelineVariantsPending && pipelineRegistry.pendingCount() == 0 )
+		{
+			pipelineVariantsPending = false;
+			std::cout << "All " << pipelineVariants.size() << " pipeline variants ready "
+				<< std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - pipelineVariantsRequested ).count()
+				<< " ms after startup, frame " << frameNumber << std::endl;
+		}
+	}
+
+	// Records one secondary command buffer per worker, in parallel, each covering
+	// an even share of the frame's draws
+	void recordSecondaryCommandBuffers( size_t frameSlot, uint32_t imageIndex, std::vector<VkCommandBuffer> &secondaryCommandBuffers )
+	{
+		uint32_t workerCount = recordingPool->size();
+		uint32_t drawsPerWorker = ( config.drawCount + workerCount - 1 ) / workerCount;
+
+		recordingPool->runOnAll( [&]( uint32_t workerIndex )
+		{
+			RecordingWorker &worker = recordingWorkers[workerIndex];
+			VkCommandBuffer commandBuffer = worker.commandBuffers[frameSlot];
+
+			// Everything allocated from this pool belongs to the frame that just
+			// finished, so the whole pool can be recycled at once
+			vkResetCommandPool( logicalDevice, worker.commandPools[frameSlot], 0 );
+
+			VkCommandBufferInheritanceInfo inheritanceInfo = {};
+			inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+			inheritanceInfo.renderPass = renderPass;
+			inheritanceInfo.subpass = 0;
+			inheritanceInfo.framebuffer = swapChainFramebuffers[imageIndex];
+
+			VkCommandBufferBeginInfo beginInfo = {};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+			beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+			if ( vkBeginCommandBuffer( commandBuffer, &beginInfo ) != VK_SUCCESS )
+			{
+				throw std::runtime_error( "failed to begin recording secondary command buffer!" );
+			}
+
+			uint32_t firstDraw = std::min( workerIndex * drawsPerWorker, config.drawCount );
+			uint32_t drawCount = std::min( drawsPerWorker, config.drawCount - firstDraw );
+			recordDraws( commandBuffer, frameSlot, firstDraw, drawCount );
+
+			if ( vkEndCommandBuffer( commandBuffer ) != VK_SUCCESS )
+			{
+				throw std::runtime_error( "failed to record secondary command buffer!" );
+			}
+		} );
+
+		secondaryCommandBuffers.clear();
+		for ( const auto &worker : recordingWorkers )
+		{
+			secondaryCommandBuffers.push_back( worker.commandBuffers[frameSlot] );
+		}
+	}
+
+	// Records the primary command buffer of frameSlot rendering into imageIndex.
+	// Must only be called once the slot's last frame has completed.
+	void recordCommandBuffer( size_t frameSlot, uint32_t imageIndex )
+	{
+		resolveDrawPipelines();
+		frameCamera = cameraForFrame( frameNumber );
+
+		if ( recordingPool )
+		{
+			recordSecondaryCommandBuffers( frameSlot, imageIndex, frameSecondaryCommandBuffers );
+		}
+
+		VkCommandBuffer commandBuffer = commandBuffers[frameSlot];
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = nullptr;
+
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS )
+		{
+			throw std::runtime_error( " failed to begin recording command buffer!" );
+		}
+
+		if ( gpuTimestampsEnabled )
+		{
+			vkCmdResetQueryPool( commandBuffer, timestampQueryPools[frameSlot], 0, 2 );
+		}
+
+		if ( uploadRing.hasPendingCopies() )
+		{
+			recordUploads( commandBuffer, frameSlot );
+		}
+
+		if ( asyncCompute )
+		{
+			recordComputeCommandBuffer( frameSlot );
+			recordCullingAcquire( commandBuffer, frameSlot );
+		}
+		else if ( gpuCulling )
+		{
+			recordCulling( commandBuffer, frameSlot );
+		}
+
+		// The render graph records its passes along with their barriers
+		const std::vector<VkImage> &images = config.headless ? offscreenImages : swapChainImages;
+		recordingFrameSlot = frameSlot;
+		renderGraph.bindImage( presentTarget, images[imageIndex], swapChainImageViews[imageIndex] );
+		renderGraph.setFramebuffer( scenePass, swapChainFramebuffers[imageIndex] );
+		renderGraph.setSubpassContents( scenePass, recordingPool ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE );
+
+		// GPU time covers the render passes only. Uploads and culling run on
+		// other queues with dedicated queue families, which would otherwise
+		// change what is measured.
+		if ( gpuTimestampsEnabled )
+		{
+			vkCmdWriteTimestamp( commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPools[frameSlot], 0 );
+		}
+		renderGraph.execute( commandBuffer, swapChainExtent );
+		if ( gpuTimestampsEnabled )
+		{
+			vkCmdWriteTimestamp( commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPools[frameSlot], 1 );
+			timestampPendingFrames[frameSlot] = frameNumber;
+		}
+
+		if ( gpuCulling )
+		{
+			recordCullingReadback( commandBuffer, frameSlot );
+		}
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to record command buffer!" );
+		}
+	}
+
+	// Inside the scene pass's render pass
+	void recordScenePass( VkCommandBuffer commandBuffer )
+	{
+		if ( recordingPool )
+		{
+			vkCmdExecuteCommands( commandBuffer, static_cast<uint32_t>(frameSecondaryCommandBuffers.size()), frameSecondaryCommandBuffers.data() );
+		}
+		else
+		{
+			recordDraws( commandBuffer, recordingFrameSlot, 0, config.drawCount );
+		}
+	}
+
+	void runRecordingBenchmark()
+	{
+		// Records the same frame repeatedly without submitting it, once inline and
+		// then with a growing number of workers, to show how recording scales
+		const uint32_t iterations = 50;
+
+		std::vector<uint32_t> workerCounts = { 0, 1, 2, 4, 8 };
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		if ( hardwareThreads > 8 )
+		{
+			workerCounts.push_back( hardwareThreads );
+		}
+
+		std::cout << "Recording benchmark: " << config.drawCount << " draws, " << iterations << " iterations" << std::endl;
+
+		double baselineMs = 0.0;
+		for ( uint32_t workerCount : workerCounts )
+		{
+			destroyRecordingWorkers();
+			createRecordingWorkers( workerCount );
+
+			// Warm up the pools so their first growth is not part of the measurement
+			recordCommandBuffer( 0, 0 );
+
+			auto start = std::chrono::steady_clock::now();
+			for ( uint32_t i = 0; i < iterations; i++ )
+			{
+				recordCommandBuffer( 0, 0 );
+			}
+			double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count() / iterations;
+
+			if ( workerCount == 0 )
+			{
+				baselineMs = ms;
+			}
+
+			std::cout << "  " << ( workerCount == 0 ? std::string( "inline" ) : std::to_string( workerCount ) + " threads" )
+				<< ": " << ms << " ms/frame, " << ( ms * 1.0e6 / std::max( config.drawCount, 1u ) ) << " ns/draw, speedup "
+				<< ( baselineMs / ms ) << "x" << std::endl;
+		}
+
+		// The pending timestamp and culling readback slots were never submitted
+		std::fill( timestampPendingFrames.begin(), timestampPendingFrames.end(), UINT64_MAX );
+		for ( auto &frame : cullingFrames )
+		{
+			frame.readbackPending = false;
+		}
+	}
+
+	// Zoomed-in views pan slowly around the scene, so the set of visible objects
+	// changes from frame to frame
+	CameraData cameraForFrame( uint64_t frame ) const
+	{
+		CameraData camera = {};
+		camera.zoom = config.cameraZoom;
+
+		float panRadius = std::max( 0.0f, 1.0f - 1.0f / camera.zoom );
+		float angle = frame * 0.01f;
+		camera.offset[0] = panRadius * std::cos( angle );
+		camera.offset[1] = panRadius * std::sin( angle );
+		return camera;
+	}
+
+	// Rewrites the vertex colours, pulsing over time, straight into the upload
+	// ring and queues their copy to a pooled vertex buffer for this frame
+	void streamFrameData()
+	{
+		updateTextures();
+
+		if ( !config.streamVertices )
+		{
+			return;
+		}
+
+		VkDeviceSize vertexBytes = sizeof( vertices[0] ) * vertices.size();
+		UploadAllocation allocation = allocateUpload( vertexBytes );
+
+		float brightness = 0.625f + 0.375f * std::sin( frameNumber * 0.05f );
+		Vertex *streamed = static_cast<Vertex *>(allocation.mapped);
+		for ( size_t i = 0; i < vertices.size(); i++ )
+		{
+			uint32_t color = vertices[i].color;
+			uint32_t scaled = color & 0xff000000;
+			for ( int shift = 0; shift < 24; shift += 8 )
+			{
+				scaled |= static_cast<uint32_t>( ( ( color >> shift ) & 0xff ) * brightness ) << shift;
+			}
+
+			streamed[i].pos[0] = vertices[i].pos[0];
+			streamed[i].pos[1] = vertices[i].pos[1];
+			streamed[i].color = scaled;
+		}
+
+		frameVertexBuffer = streamBufferPool.acquire( vertexBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT );
+		uploadRing.copyToBuffer( allocation, vertexBytes, frameVertexBuffer.buffer, 0 );
+		streamBufferPool.release( frameVertexBuffer, frameNumber );
+	}
+
+	// One memcpy into the frame slot's uniform region animates every object;
+	// the slot's previous frame has completed by now
+	void updateFrameUniforms()
+	{
+		FrameUniforms uniforms = {};
+		uniforms.time = frameNumber / 60.0f;
+		uniforms.motionAmplitude = config.objectMotion;
+		uniformRing.write( currentFrame, &uniforms, sizeof( uniforms ) );
+	}
+
+	// Moves on to the next texture every textureSwitchFrames frames, hands newly
+	// decoded textures to the upload ring and points the frame's draws at the
+	// texture on screen, or the fallback while there is none. Without bindless
+	// textures that means rewriting the frame slot's descriptor set.
+	void updateTextures()
+	{
+		if ( !config.texturePaths.empty() && frameNumber % config.textureSwitchFrames == 0 )
+		{
+			textureCache.release( requestedTexture );
+			requestedTexture = textureCache.acquire( config.texturePaths[nextTexturePath] );
+			nextTexturePath = ( nextTexturePath + 1 ) % config.texturePaths.size();
+		}
+
+		textureCache.queueUploads();
+
+		if ( requestedTexture != TextureCache::INVALID_TEXTURE &&
+			( textureCache.view( requestedTexture ) != VK_NULL_HANDLE || textureCache.isFailed( requestedTexture ) ) )
+		{
+			textureCache.release( displayedTexture );
+			displayedTexture = requestedTexture;
+			requestedTexture = TextureCache::INVALID_TEXTURE;
+		}
+
+		TextureCache::TextureId texture = displayedTexture;
+		VkImageView view = VK_NULL_HANDLE;
+		if ( texture != TextureCache::INVALID_TEXTURE )
+		{
+			view = textureCache.view( texture );
+		}
+		if ( view == VK_NULL_HANDLE )
+		{
+			texture = textureCache.fallbackTexture();
+			view = textureCache.view( texture );
+		}
+
+		if ( bindlessTextures )
+		{
+			frameTextureIndex = textureCache.descriptorIndex( texture );
+			return;
+		}
+
+		if ( descriptorTextureEvictions != textureCache.evictionCount() )
+		{
+			descriptorTextureEvictions = textureCache.evictionCount();
+			std::fill( descriptorTextureViews.begin(), descriptorTextureViews.end(), VK_NULL_HANDLE );
+		}
+		if ( descriptorTextureViews[currentFrame] != view )
+		{
+			writeTexture( descriptorSets[currentFrame], view );
+			descriptorTextureViews[currentFrame] = view;
+		}
+	}
+
+	// Space for this frame's uploads. When the ring is full the CPU blocks on the
+	// oldest frame still holding ring space, which counts as a stall.
+	UploadAllocation allocateUpload( VkDeviceSize size )
+	{
+		UploadAllocation allocation;
+		while ( !uploadRing.tryAllocate( size, UPLOAD_ALIGNMENT, allocation ) )
+		{
+			uint64_t oldestFrame = uploadRing.oldestPendingFrame();
+			if ( oldestFrame == UINT64_MAX )
+			{
+				throw std::runtime_error( "upload ring too small for one frame's uploads!" );
+			}
+
+			auto waitStart = std::chrono::steady_clock::now();
+			waitForFrame( oldestFrame );
+			double waitMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - waitStart ).count();
+			uploadRing.addStall( waitMs );
+			frameBlockedMs += waitMs;
+
+			uploadRing.reclaim( [this]( uint64_t frame ) { return isFrameComplete( frame ); } );
+		}
+		return allocation;
+	}
+
+	// Records the copies queued in the upload ring. With a dedicated transfer
+	// queue they go into the slot's transfer command buffer, released to the
+	// graphics queue and acquired here once submitFrame() has waited on them.
+	// Pooled destinations were last owned by the graphics queue, but their old
+	// contents are overwritten, so the transfer queue never acquires them.
+	// Texture mip chains are always blitted here, on the graphics queue.
+	void recordUploads( VkCommandBuffer commandBuffer, size_t frameSlot )
+	{
+		uint32_t transferFamily = selectedQueueFamilies.transferFamily.value();
+		uint32_t graphicsFamily = selectedQueueFamilies.graphicsFamily.value();
+		bool textureUploads = textureCache.hasPendingUploads();
+
+		std::vector<VkBufferMemoryBarrier> barriers;
+		for ( VkBuffer buffer : uploadRing.pendingBufferDestinations() )
+		{
+			VkBufferMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = UPLOAD_CONSUMER_ACCESS;
+			barrier.srcQueueFamilyIndex = asyncTransfer ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = asyncTransfer ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = buffer;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+			barriers.push_back( barrier );
+		}
+
+		if ( !asyncTransfer )
+		{
+			if ( textureUploads )
+			{
+				textureCache.recordCopyBarriers( commandBuffer );
+			}
+			uploadRing.recordCopies( commandBuffer );
+			if ( !barriers.empty() )
+			{
+				vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, UPLOAD_CONSUMER_STAGES, 0,
+					0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr );
+			}
+			if ( textureUploads )
+			{
+				textureCache.recordMipGeneration( commandBuffer );
+			}
+			return;
+		}
+
+		VkCommandBuffer transferCommandBuffer = transferCommandBuffers[frameSlot];
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if ( vkBeginCommandBuffer( transferCommandBuffer, &beginInfo ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to begin recording transfer command buffer!" );
+		}
+
+		if ( textureUploads )
+		{
+			textureCache.recordCopyBarriers( transferCommandBuffer );
+		}
+		uploadRing.recordCopies( transferCommandBuffer );
+		if ( !barriers.empty() )
+		{
+			vkCmdPipelineBarrier( transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+				0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr );
+		}
+		if ( textureUploads )
+		{
+			textureCache.recordUploadRelease( transferCommandBuffer, transferFamily, graphicsFamily );
+		}
+
+		if ( vkEndCommandBuffer( transferCommandBuffer ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to record transfer command buffer!" );
+		}
+		uploadSubmissionPending = true;
+
+		// Chained to the semaphore wait, which happens at the same stages. Mip
+		// generation reads the uploaded level at the transfer stage.
+		uploadWaitStages = UPLOAD_CONSUMER_STAGES;
+		if ( !barriers.empty() )
+		{
+			for ( auto &barrier : barriers )
+			{
+				barrier.srcAccessMask = 0;
+			}
+			vkCmdPipelineBarrier( commandBuffer, UPLOAD_CONSUMER_STAGES, UPLOAD_CONSUMER_STAGES, 0,
+				0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr );
+		}
+		if ( textureUploads )
+		{
+			uploadWaitStages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+			textureCache.recordUploadAcquire( commandBuffer, transferFamily, graphicsFamily );
+			textureCache.recordMipGeneration( commandBuffer );
+		}
+	}
+
+	void submitUploads()
+	{
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &transferCommandBuffers[currentFrame];
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &uploadCompleteSemaphores[currentFrame];
+
+		if ( vkQueueSubmit( transferQueue, 1, &submitInfo, VK_NULL_HANDLE ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to submit upload command buffer!" );
+		}
+		uploadSubmissionPending = false;
+	}
+
+	// Resets the frame's draw commands to zero instances and runs cull.comp,
+	// which appends every visible object to its variant's range of the visible
+	// list and bumps that variant's instance count
+	void recordCulling( VkCommandBuffer commandBuffer, size_t frameSlot )
+	{
+		CullingFrame &frame = cullingFrames[frameSlot];
+
+		VkBufferCopy copyRegion = {};
+		copyRegion.size = sizeof( VkDrawIndexedIndirectCommand ) * pipelineVariants.size();
+		vkCmdCopyBuffer( commandBuffer, indirectBuffer.buffer, frame.drawCommands.buffer, 1, &copyRegion );
+
+		VkBufferMemoryBarrier resetBarrier = {};
+		resetBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		resetBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		resetBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		resetBarrier.buffer = frame.drawCommands.buffer;
+		resetBarrier.offset = 0;
+		resetBarrier.size = VK_WHOLE_SIZE;
+
+		vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			0, nullptr, 1, &resetBarrier, 0, nullptr );
+
+		CullingParameters parameters = {};
+		computeFrustumPlanes( frameCamera, parameters.planes );
+		parameters.objectCount = config.drawCount;
+		parameters.motionRadius = config.objectMotion;
+
+		vkCmdBindPipeline( commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullingPipeline );
+		vkCmdBindDescriptorSets( commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullingPipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr );
+		vkCmdPushConstants( commandBuffer, cullingPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof( parameters ), &parameters );
+		vkCmdDispatch( commandBuffer, ( config.drawCount + CULLING_GROUP_SIZE - 1 ) / CULLING_GROUP_SIZE, 1, 1 );
+
+		// The draw commands are consumed as indirect parameters and copied back
+		// after the render pass, the visible list is read by the vertex shader.
+		// From a dedicated compute queue this is the release half of an
+		// ownership transfer to the graphics queue.
+		VkBufferMemoryBarrier cullBarriers[2];
+		cullingOutputBarriers( frameSlot, cullBarriers );
+		for ( auto &barrier : cullBarriers )
+		{
+			barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			if ( asyncCompute )
+			{
+				barrier.dstAccessMask = 0;
+			}
+		}
+
+		VkPipelineStageFlags dstStages = CULLING_OUTPUT_STAGES;
+		if ( asyncCompute )
+		{
+			dstStages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		}
+		vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStages, 0,
+			0, nullptr, 2, cullBarriers, 0, nullptr );
+	}
+
+	// Barriers over the draw commands and visible list on their way from the
+	// culling pass to the graphics pass, with the consumers' access masks
+	void cullingOutputBarriers( size_t frameSlot, VkBufferMemoryBarrier barriers[2] )
+	{
+		for ( int i = 0; i < 2; i++ )
+		{
+			barriers[i] = {};
+			barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barriers[i].srcQueueFamilyIndex = asyncCompute ? selectedQueueFamilies.computeFamily.value() : VK_QUEUE_FAMILY_IGNORED;
+			barriers[i].dstQueueFamilyIndex = asyncCompute ? selectedQueueFamilies.graphicsFamily.value() : VK_QUEUE_FAMILY_IGNORED;
+			barriers[i].offset = 0;
+			barriers[i].size = VK_WHOLE_SIZE;
+		}
+
+		barriers[0].buffer = cullingFrames[frameSlot].drawCommands.buffer;
+		barriers[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		barriers[1].buffer = cullingFrames[frameSlot].visibleObjects.buffer;
+		barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	}
+
+	// The culling pass of a frame slot on the dedicated compute queue. The
+	// buffers it writes were last owned by the graphics queue, but their old
+	// contents are never read, so they are written without being acquired.
+	void recordComputeCommandBuffer( size_t frameSlot )
+	{
+		VkCommandBuffer commandBuffer = computeCommandBuffers[frameSlot];
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if ( vkBeginCommandBuffer( commandBuffer, &beginInfo ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to begin recording compute command buffer!" );
+		}
+
+		recordCulling( commandBuffer, frameSlot );
+
+		if ( vkEndCommandBuffer( commandBuffer ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to record compute command buffer!" );
+		}
+	}
+
+	// Acquire half of the ownership transfer released by recordCulling()
+	void recordCullingAcquire( VkCommandBuffer commandBuffer, size_t frameSlot )
+	{
+		VkBufferMemoryBarrier acquireBarriers[2];
+		cullingOutputBarriers( frameSlot, acquireBarriers );
+
+		// Chained to the semaphore wait, which happens at the same stages
+		vkCmdPipelineBarrier( commandBuffer, CULLING_OUTPUT_STAGES, CULLING_OUTPUT_STAGES, 0,
+			0, nullptr, 2, acquireBarriers, 0, nullptr );
+	}
+
+	void submitCulling()
+	{
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &computeCommandBuffers[currentFrame];
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &cullingCompleteSemaphores[currentFrame];
+
+		if ( vkQueueSubmit( computeQueue, 1, &submitInfo, VK_NULL_HANDLE ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to submit culling command buffer!" );
+		}
+	}
+
+	void recordCullingReadback( VkCommandBuffer commandBuffer, size_t frameSlot )
+	{
+		CullingFrame &frame = cullingFrames[frameSlot];
+
+		VkBufferCopy copyRegion = {};
+		copyRegion.size = sizeof( VkDrawIndexedIndirectCommand ) * pipelineVariants.size();
+		vkCmdCopyBuffer( commandBuffer, frame.drawCommands.buffer, frame.readback.buffer, 1, &copyRegion );
+
+		VkBufferMemoryBarrier hostBarrier = {};
+		hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		hostBarrier.buffer = frame.readback.buffer;
+		hostBarrier.offset = 0;
+		hostBarrier.size = VK_WHOLE_SIZE;
+
+		vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+			0, nullptr, 1, &hostBarrier, 0, nullptr );
+
+		frame.readbackPending = true;
+	}
+
+	// Only called once the slot's last frame has completed, like collectGpuTimestamps()
+	void collectCullingCounters( size_t frameSlot )
+	{
+		if ( !gpuCulling || !cullingFrames[frameSlot].readbackPending )
+		{
+			return;
+		}
+
+		auto drawCommands = static_cast<const VkDrawIndexedIndirectCommand *>(cullingFrames[frameSlot].readback.allocation.mapped);
+		for ( size_t group = 0; group < pipelineVariants.size(); group++ )
+		{
+			visibleObjectTotal += drawCommands[group].instanceCount;
+		}
+		culledFrameCount++;
+
+		cullingFrames[frameSlot].readbackPending = false;
+	}
+
+	void reportCulling()
+	{
+		if ( !gpuCulling )
+		{
+			return;
+		}
+
+		// Pick up the counters of the frames that were still in flight
+		for ( size_t i = 0; i < cullingFrames.size(); i++ )
+		{
+			collectCullingCounters( i );
+		}
+
+		if ( culledFrameCount == 0 )
+		{
+			return;
+		}
+
+		double visible = static_cast<double>(visibleObjectTotal) / culledFrameCount;
+		runStatistics.meanVisibleObjects = visible;
+		std::cout << "GPU culling: " << config.drawCount << " objects, " << visible << " visible and "
+			<< config.drawCount - visible << " culled per frame on average (" << 100.0 * ( 1.0 - visible / config.drawCount )
+			<< "% culled over " << culledFrameCount << " frames)" << std::endl;
+	}
+
+	void createTimestampQueries()
+	{
+		if ( !config.profile )
+		{
+			return;
+		}
+
+		const VkPhysicalDeviceProperties &properties = deviceCapabilities.properties;
+
+		uint32_t validBits = deviceCapabilities.queueFamilies[selectedQueueFamilies.graphicsFamily.value()].timestampValidBits;
+		if ( validBits == 0 )
+		{
+			std::cout << "Profiler: graphics queue does not support timestamps, GPU times disabled" << std::endl;
+			return;
+		}
+
+		gpuTimestampsEnabled = true;
+		timestampPeriod = properties.limits.timestampPeriod;
+		timestampMask = validBits >= 64 ? UINT64_MAX : ( ( 1ULL << validBits ) - 1 );
+
+		timestampQueryPools.resize( frameSlotCount );
+		timestampPendingFrames.resize( frameSlotCount, UINT64_MAX );
+
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2;
+
+		for ( size_t i = 0; i < frameSlotCount; i++ )
+		{
+			if ( vkCreateQueryPool( logicalDevice, &queryPoolInfo, vulkanHostAllocator, &timestampQueryPools[i] ) != VK_SUCCESS )
+			{
+				throw std::runtime_error( "failed to create timestamp query pool!" );
+			}
+		}
+	}
+
+	void collectGpuTimestamps( size_t frameSlot )
+	{
+		if ( !gpuTimestampsEnabled || timestampPendingFrames[frameSlot] == UINT64_MAX )
+		{
+			return;
+		}
+
+		// Only called once the slot's last frame has completed, so the results are
+		// available and this never stalls. No WAIT_BIT, just in case.
+		uint64_t timestamps[2] = {};
+		VkResult result = vkGetQueryPoolResults( logicalDevice, timestampQueryPools[frameSlot], 0, 2,
+												 sizeof( timestamps ), timestamps, sizeof( uint64_t ), VK_QUERY_RESULT_64_BIT );
+		if ( result == VK_SUCCESS )
+		{
+			uint64_t ticks = ( timestamps[1] - timestamps[0] ) & timestampMask;
+			profiler.addGpuTime( timestampPendingFrames[frameSlot], ticks * timestampPeriod / 1.0e6 );
+		}
+
+		timestampPendingFrames[frameSlot] = UINT64_MAX;
+	}
+
+	// Concurrent buffers can be used from every queue family without ownership
+	// transfers, which suits data that is only ever read once uploaded
+	void createBuffer( VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, GpuBuffer &buffer, bool concurrent = false )
+	{
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if ( concurrent && uniqueQueueFamilies.size() > 1 )
+		{
+			bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(uniqueQueueFamilies.size());
+			bufferInfo.pQueueFamilyIndices = uniqueQueueFamilies.data();
+		}
+
+		if ( vkCreateBuffer( logicalDevice, &bufferInfo, vulkanHostAllocator, &buffer.buffer ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create buffer!" );
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements( logicalDevice, buffer.buffer, &memRequirements );
+
+		buffer.allocation = gpuAllocator.allocate( memRequirements, properties, true );
+		vkBindBufferMemory( logicalDevice, buffer.buffer, buffer.allocation.memory, buffer.allocation.offset );
+	}
+
+	void destroyBuffer( GpuBuffer &buffer )
+	{
+		vkDestroyBuffer( logicalDevice, buffer.buffer, vulkanHostAllocator );
+		gpuAllocator.free( buffer.allocation );
+		buffer.buffer = VK_NULL_HANDLE;
+	}
+
+	// Records into a throwaway command buffer from pool and blocks until queue
+	// has run it. Only meant for one-off work at load time.
+	template <typename RecordFunction>
+	void submitImmediate( VkQueue queue, VkCommandPool pool, RecordFunction record )
+	{
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = pool;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		if ( vkAllocateCommandBuffers( logicalDevice, &allocInfo, &commandBuffer ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to allocate command buffers!" );
+		}
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		vkBeginCommandBuffer( commandBuffer, &beginInfo );
+		record( commandBuffer );
+		vkEndCommandBuffer( commandBuffer );
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+
+		if ( vkQueueSubmit( queue, 1, &submitInfo, VK_NULL_HANDLE ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to submit upload command buffer!" );
+		}
+		vkQueueWaitIdle( queue );
+
+		vkFreeCommandBuffers( logicalDevice, pool, 1, &commandBuffer );
+	}
+
+	// Runs the copies on the transfer queue. Buffers owned by another queue
+	// family are released by the transfer queue and acquired by their owner
+	// before this returns.
+	void uploadBuffers( const std::vector<BufferUpload> &uploads )
+	{
+		uint32_t transferFamily = selectedQueueFamilies.transferFamily.value();
+
+		submitImmediate( transferQueue, transferCommandPool, [&]( VkCommandBuffer commandBuffer )
+		{
+			std::vector<VkBufferMemoryBarrier> barriers;
+			for ( const auto &upload : uploads )
+			{
+				VkBufferCopy copyRegion = {};
+				copyRegion.srcOffset = upload.sourceOffset;
+				copyRegion.size = upload.size;
+				vkCmdCopyBuffer( commandBuffer, upload.source, upload.destination, 1, &copyRegion );
+
+				bool transferOwnership = upload.ownerFamily != VK_QUEUE_FAMILY_IGNORED && upload.ownerFamily != transferFamily;
+
+				VkBufferMemoryBarrier barrier = {};
+				barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = transferOwnership ? 0 : VK_ACCESS_MEMORY_READ_BIT;
+				barrier.srcQueueFamilyIndex = transferOwnership ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = transferOwnership ? upload.ownerFamily : VK_QUEUE_FAMILY_IGNORED;
+				barrier.buffer = upload.destination;
+				barrier.offset = 0;
+				barrier.size = VK_WHOLE_SIZE;
+				barriers.push_back( barrier );
+			}
+
+			vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+				0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr );
+		} );
+
+		// The transfer queue is idle, so the acquires need no semaphore
+		for ( uint32_t family : uniqueQueueFamilies )
+		{
+			if ( family == transferFamily )
+			{
+				continue;
+			}
+
+			std::vector<VkBufferMemoryBarrier> barriers;
+			for ( const auto &upload : uploads )
+			{
+				if ( upload.ownerFamily != family )
+				{
+					continue;
+				}
+
+				VkBufferMemoryBarrier barrier = {};
+				barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+				barrier.srcQueueFamilyIndex = transferFamily;
+				barrier.dstQueueFamilyIndex = family;
+				barrier.buffer = upload.destination;
+				barrier.offset = 0;
+				barrier.size = VK_WHOLE_SIZE;
+				barriers.push_back( barrier );
+			}
+
+			if ( barriers.empty() )
+			{
+				continue;
+			}
+
+			bool graphics = family == selectedQueueFamilies.graphicsFamily.value();
+			submitImmediate( graphics ? graphicsQueue : computeQueue, graphics ? commandPool : computeCommandPool, [&]( VkCommandBuffer commandBuffer )
+			{
+				vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+					0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr );
+			} );
+		}
+	}
+
+	void createMeshBuffers()
+	{
+		generateTriangleGrid( config.triangleCount, vertices, indices );
+
+		// Vertices and indices go through one host-visible staging buffer and are
+		// copied into device-local buffers with a single submit
+		VkDeviceSize vertexBytes = sizeof( vertices[0] ) * vertices.size();
+		VkDeviceSize indexBytes = sizeof( indices[0] ) * indices.size();
+
+		GpuBuffer stagingBuffer;
+		createBuffer( vertexBytes + indexBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer );
+
+		char *staging = static_cast<char *>(stagingBuffer.allocation.mapped);
+		memcpy( staging, vertices.data(), static_cast<size_t>(vertexBytes) );
+		memcpy( staging + vertexBytes, indices.data(), static_cast<size_t>(indexBytes) );
+
+		createBuffer( vertexBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer );
+		createBuffer( indexBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer );
+
+		uint32_t graphicsFamily = selectedQueueFamilies.graphicsFamily.value();
+		uploadBuffers( {
+			{ stagingBuffer.buffer, 0, vertexBuffer.buffer, vertexBytes, graphicsFamily },
+			{ stagingBuffer.buffer, vertexBytes, indexBuffer.buffer, indexBytes, graphicsFamily }
+		} );
+
+		destroyBuffer( stagingBuffer );
+	}
+
+	// Creates a device-local buffer holding a copy of data, uploaded through a
+	// temporary staging buffer. ownerFamily as in BufferUpload.
+	void createDeviceLocalBuffer( const void *data, VkDeviceSize size, VkBufferUsageFlags usage, GpuBuffer &buffer, uint32_t ownerFamily )
+	{
+		GpuBuffer stagingBuffer;
+		createBuffer( size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer );
+		memcpy( stagingBuffer.allocation.mapped, data, static_cast<size_t>(size) );
+
+		createBuffer( size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer,
+			ownerFamily == VK_QUEUE_FAMILY_IGNORED );
+
+		uploadBuffers( { { stagingBuffer.buffer, 0, buffer.buffer, size, ownerFamily } } );
+
+		destroyBuffer( stagingBuffer );
+	}
+
+	void createInstanceBuffers()
+	{
+		generateObjectGrid( config.drawCount, instances );
+		for ( size_t group = 0; group < pipelineVariants.size(); group++ )
+		{
+			for ( uint32_t i = groupFirstObject( group ); i < groupFirstObject( group + 1 ); i++ )
+			{
+				instances[i].variant = static_cast<uint32_t>(group);
+			}
+		}
+		// Read by the vertex shader and, on the compute queue, by the culling pass
+		uint32_t graphicsFamily = selectedQueueFamilies.graphicsFamily.value();
+		createDeviceLocalBuffer( instances.data(), sizeof( instances[0] ) * instances.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, instanceBuffer,
+			asyncCompute ? VK_QUEUE_FAMILY_IGNORED : graphicsFamily );
+
+		uint32_t drawCalls = config.drawCount;
+		if ( drawMode != DrawMode::Direct )
+		{
+			drawCalls = 0;
+			for ( size_t group = 0; group < pipelineVariants.size(); group++ )
+			{
+				drawCalls += groupFirstObject( group + 1 ) > groupFirstObject( group ) ? 1 : 0;
+			}
+		}
+
+		if ( drawMode == DrawMode::Indirect )
+		{
+			// One command per pipeline variant, empty groups draw zero instances.
+			// When culling, every count starts at zero and is filled in by cull.comp.
+			std::vector<VkDrawIndexedIndirectCommand> drawCommands( pipelineVariants.size() );
+			for ( size_t group = 0; group < drawCommands.size(); group++ )
+			{
+				drawCommands[group].indexCount = static_cast<uint32_t>(indices.size());
+				drawCommands[group].instanceCount = gpuCulling ? 0 : groupFirstObject( group + 1 ) - groupFirstObject( group );
+				drawCommands[group].firstIndex = 0;
+				drawCommands[group].vertexOffset = 0;
+				drawCommands[group].firstInstance = groupFirstObject( group );
+			}
+
+			createDeviceLocalBuffer( drawCommands.data(), sizeof( drawCommands[0] ) * drawCommands.size(),
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, indirectBuffer,
+				asyncCompute ? selectedQueueFamilies.computeFamily.value() : graphicsFamily );
+		}
+
+		if ( !gpuCulling )
+		{
+			runStatistics.meanVisibleObjects = config.drawCount;
+
+			std::vector<uint32_t> objectIndices( config.drawCount );
+			for ( uint32_t i = 0; i < config.drawCount; i++ )
+			{
+				objectIndices[i] = i;
+			}
+			createDeviceLocalBuffer( objectIndices.data(), sizeof( objectIndices[0] ) * objectIndices.size(),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, objectIndexBuffer, graphicsFamily );
+		}
+
+		std::cout << "Draw mode " << drawModeName( drawMode ) << ( gpuCulling ? " with GPU culling" : "" ) << ": "
+			<< config.drawCount << " objects in " << drawCalls << " draw calls per frame" << std::endl;
+
+		if ( !gpuCulling )
+		{
+			gpuAllocator.report( std::cout );
+		}
+	}
+
+	void createCullingFrames()
+	{
+		VkDeviceSize commandBytes = sizeof( VkDrawIndexedIndirectCommand ) * pipelineVariants.size();
+
+		cullingFrames.resize( frameSlotCount );
+		for ( auto &frame : cullingFrames )
+		{
+			createBuffer( commandBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.drawCommands );
+			createBuffer( sizeof( uint32_t ) * config.drawCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.visibleObjects );
+			createBuffer( commandBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.readback );
+		}
+
+		gpuAllocator.report( std::cout );
+	}
+
+	void createDescriptorSetLayout()
+	{
+		// The vertex shader reads each object's InstanceData through the list of
+		// object indices, by gl_InstanceIndex, and its FrameUniforms at a dynamic
+		// offset. The fragment shader samples the texture on screen.
+		VkDescriptorSetLayoutBinding bindings[4] = {};
+		for ( uint32_t i = 0; i < 2; i++ )
+		{
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		}
+		bindings[2].binding = 2;
+		bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[2].descriptorCount = 1;
+		bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		bindings[3].binding = 3;
+		bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		bindings[3].descriptorCount = 1;
+		bindings[3].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = 4;
+		layoutInfo.pBindings = bindings;
+
+		if ( vkCreateDescriptorSetLayout( logicalDevice, &layoutInfo, vulkanHostAllocator, &descriptorSetLayout ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create descriptor set layout!" );
+		}
+	}
+
+	// One graphics set per frame slot and, when culling, one culling set per
+	// frame slot. Graphics sets start out with the fallback texture.
+	void createDescriptorSets()
+	{
+		uint32_t setCount = frameSlotCount * ( gpuCulling ? 2 : 1 );
+
+		VkDescriptorPoolSize poolSizes[3] = {};
+		poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		poolSizes[0].descriptorCount = frameSlotCount * ( gpuCulling ? 5 : 2 );
+		poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSizes[1].descriptorCount = frameSlotCount;
+		poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		poolSizes[2].descriptorCount = frameSlotCount;
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.poolSizeCount = 3;
+		poolInfo.pPoolSizes = poolSizes;
+		poolInfo.maxSets = setCount;
+
+		if ( vkCreateDescriptorPool( logicalDevice, &poolInfo, vulkanHostAllocator, &descriptorPool ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create descriptor pool!" );
+		}
+
+		textureSampler = textureCache.sampler( VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT );
+		descriptorTextureViews.assign( frameSlotCount, textureCache.fallbackView() );
+
+		descriptorSets = allocateDescriptorSets( descriptorSetLayout, frameSlotCount );
+		for ( size_t i = 0; i < frameSlotCount; i++ )
+		{
+			VkBuffer objectIndices = gpuCulling ? cullingFrames[i].visibleObjects.buffer : objectIndexBuffer.buffer;
+			writeStorageBuffers( descriptorSets[i], { instanceBuffer.buffer, objectIndices } );
+			writeTexture( descriptorSets[i], descriptorTextureViews[i] );
+			writeFrameUniforms( descriptorSets[i] );
+		}
+
+		if ( gpuCulling )
+		{
+			std::vector<VkDescriptorSet> cullingSets = allocateDescriptorSets( cullingSetLayout, frameSlotCount );
+			for ( size_t i = 0; i < frameSlotCount; i++ )
+			{
+				cullingFrames[i].descriptorSet = cullingSets[i];
+				writeStorageBuffers( cullingSets[i], { instanceBuffer.buffer, cullingFrames[i].drawCommands.buffer, cullingFrames[i].visibleObjects.buffer } );
+			}
+		}
+	}
+
+	std::vector<VkDescriptorSet> allocateDescriptorSets( VkDescriptorSetLayout layout, uint32_t count )
+	{
+		std::vector<VkDescriptorSetLayout> layouts( count, layout );
+		std::vector<VkDescriptorSet> sets( count );
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = count;
+		allocInfo.pSetLayouts = layouts.data();
+
+		if ( vkAllocateDescriptorSets( logicalDevice, &allocInfo, sets.data() ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to allocate descriptor sets!" );
+		}
+		return sets;
+	}
+
+	// Points bindings 0, 1, ... of set at the whole of each buffer
+	void writeStorageBuffers( VkDescriptorSet set, const std::vector<VkBuffer> &buffers )
+	{
+		std::vector<VkDescriptorBufferInfo> bufferInfos( buffers.size() );
+		std::vector<VkWriteDescriptorSet> descriptorWrites( buffers.size() );
+
+		for ( size_t i = 0; i < buffers.size(); i++ )
+		{
+			bufferInfos[i].buffer = buffers[i];
+			bufferInfos[i].offset = 0;
+			bufferInfos[i].range = VK_WHOLE_SIZE;
+
+			descriptorWrites[i] = {};
+			descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[i].dstSet = set;
+			descriptorWrites[i].dstBinding = static_cast<uint32_t>(i);
+			descriptorWrites[i].dstArrayElement = 0;
+			descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[i].descriptorCount = 1;
+			descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+		}
+
+		vkUpdateDescriptorSets( logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr );
+	}
+
+	// Every set points at the start of the uniform ring; the frame slot's region
+	// is selected by the dynamic offset at bind time
+	void writeFrameUniforms( VkDescriptorSet set )
+	{
+		VkDescriptorBufferInfo bufferInfo = {};
+		bufferInfo.buffer = uniformRing.buffer();
+		bufferInfo.offset = 0;
+		bufferInfo.range = uniformRing.range();
+
+		VkWriteDescriptorSet descriptorWrite = {};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = set;
+		descriptorWrite.dstBinding = 3;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pBufferInfo = &bufferInfo;
+
+		vkUpdateDescriptorSets( logicalDevice, 1, &descriptorWrite, 0, nullptr );
+	}
+
+	void writeTexture( VkDescriptorSet set, VkImageView view )
+	{
+		VkDescriptorImageInfo imageInfo = {};
+		imageInfo.sampler = textureSampler;
+		imageInfo.imageView = view;
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkWriteDescriptorSet descriptorWrite = {};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = set;
+		descriptorWrite.dstBinding = 2;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &imageInfo;
+
+		vkUpdateDescriptorSets( logicalDevice, 1, &descriptorWrite, 0, nullptr );
+	}
+
+	void createCommandPool()
+	{
+		// The primary, compute and per-frame transfer command buffers are
+		// re-recorded every frame, load-time uploads only live for one submit
+		commandPool = createCommandPoolForFamily( selectedQueueFamilies.graphicsFamily.value(), VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT );
+		computeCommandPool = createCommandPoolForFamily( selectedQueueFamilies.computeFamily.value(), VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT );
+		transferCommandPool = createCommandPoolForFamily( selectedQueueFamilies.transferFamily.value(),
+			VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT );
+	}
+
+	VkCommandPool createCommandPoolForFamily( uint32_t queueFamily, VkCommandPoolCreateFlags flags )
+	{
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = queueFamily;
+		poolInfo.flags = flags;
+
+		VkCommandPool pool;
+		if (vkCreateCommandPool(logicalDevice, &poolInfo, vulkanHostAllocator, &pool) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create command pool!" );
+		}
+		return pool;
+	}
+	
+	void createFrameBuffers()
+	{
+		swapChainFramebuffers.resize( swapChainImageViews.size() );
+		for (size_t i = 0; i < swapChainImageViews.size(); i++ )
+		{
+			// Same order as the render pass attachments
+			std::vector<VkImageView> attachments;
+			for ( uint32_t image : renderGraph.attachments( scenePass ) )
+			{
+				attachments.push_back( image == presentTarget ? swapChainImageViews[i] : renderGraph.imageView( image ) );
+			}
+
+			VkFramebufferCreateInfo framebufferInfo = {};
+			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			framebufferInfo.renderPass = renderPass;
+			framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+			framebufferInfo.pAttachments = attachments.data();
+			framebufferInfo.width = swapChainExtent.width;
+			framebufferInfo.height = swapChainExtent.height;
+			framebufferInfo.layers = 1;
+
+			if (vkCreateFramebuffer(logicalDevice, &framebufferInfo, vulkanHostAllocator, &swapChainFramebuffers[i]) != VK_SUCCESS )
+			{
+				throw std::runtime_error( "failed to create framebuffer!" );
+			}
+		}
+	}
+
+	// The scene pass draws into the present target, or with MSAA into a
+	// multisampled target resolved into it, depth tested against a depth
+	// buffer. The graph derives the render pass, its store ops and the
+	// barriers from that, including the wait for the previous frame's use
+	// of the depth and multisampled targets, which every frame shares.
+	void createRenderGraph()
+	{
+		renderGraph.init( logicalDevice );
+
+		// Offscreen targets are never presented, leave them ready to be copied out instead
+		presentTarget = renderGraph.importImage( "present", swapChainImageFormat,
+			config.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT );
+
+		// Layout transitions of a depth/stencil image cover both aspects
+		VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+		if ( depthFormat != VK_FORMAT_D32_SFLOAT )
+		{
+			depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		depthTarget = renderGraph.createImage( "depth", depthFormat, msaaSamples, depthAspect );
+
+		scenePass = renderGraph.addPass( "scene", [this]( VkCommandBuffer commandBuffer ) { recordScenePass( commandBuffer ); } );
+		VkClearColorValue clearColor = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		if ( msaaSamples != VK_SAMPLE_COUNT_1_BIT )
+		{
+			multisampledTarget = renderGraph.createImage( "multisampled colour", swapChainImageFormat, msaaSamples, VK_IMAGE_ASPECT_COLOR_BIT );
+			renderGraph.addColorAttachment( scenePass, multisampledTarget, VK_ATTACHMENT_LOAD_OP_CLEAR, clearColor );
+			renderGraph.addResolveAttachment( scenePass, presentTarget );
+		}
+		else
+		{
+			renderGraph.addColorAttachment( scenePass, presentTarget, VK_ATTACHMENT_LOAD_OP_CLEAR, clearColor );
+		}
+		renderGraph.setDepthAttachment( scenePass, depthTarget, VK_ATTACHMENT_LOAD_OP_CLEAR, 1.0f );
+
+		renderGraph.compile();
+		renderPass = renderGraph.renderPass( scenePass );
+	}
+
+	// Picks the sample count and the depth format, both fixed for the lifetime
+	// of the render pass
+	void chooseAttachmentFormats()
+	{
+		const VkPhysicalDeviceProperties &properties = deviceCapabilities.properties;
+
+		VkSampleCountFlags supported = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+		msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+		for ( uint32_t samples = 2; samples <= config.msaaSamples && samples <= VK_SAMPLE_COUNT_64_BIT; samples *= 2 )
+		{
+			if ( supported & samples )
+			{
+				msaaSamples = static_cast<VkSampleCountFlagBits>(samples);
+			}
+		}
+		runStatistics.msaaSamples = msaaSamples;
+
+		// D32_SFLOAT is all but universal, the packed formats are fallbacks
+		const VkFormat candidates[ ] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT };
+		for ( auto format : candidates )
+		{
+			VkFormatProperties formatProperties;
+			vkGetPhysicalDeviceFormatProperties( physicalDevice, format, &formatProperties );
+			if ( formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT )
+			{
+				depthFormat = format;
+				break;
+			}
+		}
+		if ( depthFormat == VK_FORMAT_UNDEFINED )
+		{
+			throw std::runtime_error( "failed to find a supported depth format!" );
+		}
+
+		if ( msaaSamples < config.msaaSamples )
+		{
+			std::cout << "MSAA: " << config.msaaSamples << "x not supported, using " << msaaSamples << "x" << std::endl;
+		}
+	}
+
+	// Images whose contents never leave the render pass, which the render
+	// graph marks with TRANSIENT_ATTACHMENT usage, are backed by lazily
+	// allocated memory where the device has it. The allocator places images
+	// with disjoint lifetimes in the same memory.
+	void createAttachments()
+	{
+		transientImages = transientAllocator.create( renderGraph, swapChainExtent );
+		runStatistics.attachmentMiB = transientImages.aliasedBytes / ( 1024.0 * 1024.0 );
+		runStatistics.attachmentUnaliasedMiB = transientImages.unaliasedBytes / ( 1024.0 * 1024.0 );
+	}
+
+	void createGraphicsPipeline()
+	{
+		// Pipeline Layout
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		VkPushConstantRange pushConstantRanges[2] = {};
+		pushConstantRanges[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantRanges[0].offset = 0;
+		pushConstantRanges[0].size = sizeof( CameraData );
+		pushConstantRanges[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		pushConstantRanges[1].offset = sizeof( CameraData );
+		pushConstantRanges[1].size = sizeof( DrawConstants );
+
+		// Set 0 is per frame slot, set 1 the bindless texture table
+		VkDescriptorSetLayout setLayouts[2] = { descriptorSetLayout, bindlessDescriptors.layout() };
+
+		pipelineLayoutInfo.setLayoutCount = bindlessTextures ? 2 : 1;
+		pipelineLayoutInfo.pSetLayouts = setLayouts;
+		pipelineLayoutInfo.pushConstantRangeCount = bindlessTextures ? 2 : 1;
+		pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges;
+
+		if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, vulkanHostAllocator, &pipelineLayout) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create pipeline layout!" );
+		}
+
+		auto pipelineStart = std::chrono::steady_clock::now();
+
+		PipelineStateDesc defaultState;
+		defaultState.samples = msaaSamples;
+		graphicsPipeline = buildGraphicsPipeline( defaultState );
+
+		std::chrono::duration<double, std::milli> pipelineTime = std::chrono::steady_clock::now() - pipelineStart;
+		std::cout << "Graphics pipeline created in " << pipelineTime.count() << " ms (pipeline cache "
+			<< ( pipelineCacheLoaded ? "hit" : "miss" ) << ")" << std::endl;
+
+		uint32_t compileThreads = config.pipelineThreads;
+		if ( compileThreads == 0 )
+		{
+			compileThreads = std::max( 1u, std::thread::hardware_concurrency() / 2 );
+		}
+
+		pipelineRegistry.init( logicalDevice, [this]( const PipelineStateDesc &desc ) { return buildGraphicsPipeline( desc ); }, compileThreads );
+		pipelineRegistry.addFallback( defaultState, graphicsPipeline );
+
+		pipelineVariants = enumeratePipelineVariants( config.pipelineVariants, msaaSamples );
+		pipelineVariantsRequested = std::chrono::steady_clock::now();
+		pipelineVariantsPending = pipelineVariants.size() > 1;
+	}
+
+	// Up to count distinct variants, starting with the default state. All of
+	// them render into the same render pass, so they share its sample count.
+	static std::vector<PipelineStateDesc> enumeratePipelineVariants( uint32_t count, VkSampleCountFlagBits samples )
+	{
+		const VkPrimitiveTopology topologies[ ] = { VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, VK_PRIMITIVE_TOPOLOGY_LINE_STRIP };
+		const VkCullModeFlags cullModes[ ] = { VK_CULL_MODE_BACK_BIT, VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT };
+		const BlendMode blendModes[ ] = { BlendMode::Opaque, BlendMode::Alpha, BlendMode::Additive };
+
+		std::vector<PipelineStateDesc> variants;
+		for ( auto topology : topologies )
+		{
+			for ( auto cullMode : cullModes )
+			{
+				for ( auto blendMode : blendModes )
+				{
+					if ( variants.size() == count )
+					{
+						return variants;
+					}
+
+					PipelineStateDesc desc;
+					desc.topology = topology;
+					desc.cullMode = cullMode;
+					desc.blendMode = blendMode;
+					desc.samples = samples;
+					variants.push_back( desc );
+				}
+			}
+		}
+		return variants;
+	}
+
+	// Called from the pipeline registry's compile threads, so it only reads
+	// state that is fixed once createGraphicsPipeline() has run
+	VkPipeline buildGraphicsPipeline( const PipelineStateDesc &desc )
+	{
+		VkShaderModule vertShaderModule = shaderModules.get( "shaders/vert.spv" );
+		VkShaderModule fragShaderModule = shaderModules.get( bindlessTextures ? "shaders/bindless.spv" : "shaders/frag.spv" );
+
+		VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
+		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+		vertShaderStageInfo.module = vertShaderModule;
+		vertShaderStageInfo.pName = "main";
+
+		VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
+		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		fragShaderStageInfo.module = fragShaderModule;
+		fragShaderStageInfo.pName = "main";
+
+		VkPipelineShaderStageCreateInfo shaderStages[ ] = { vertShaderStageInfo, fragShaderStageInfo };
+
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		auto bindingDescription = Vertex::getBindingDescription();
+		auto attributeDescriptions = Vertex::getAttributeDescriptions();
+
+		vertexInputInfo.vertexBindingDescriptionCount = 1;
+		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+		// Input assembly
+		// 
+		// Describes what kind of geometry will be drawn from the vertices and whether
+		// primitive restart should be enabled.
+		VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
+		inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssemblyCreateInfo.topology = desc.topology;
+		inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+		// Viewport and scissor are set while recording, see recordDraws()
+		VkPipelineViewportStateCreateInfo viewportState = {};
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.pViewports = nullptr;
+		viewportState.scissorCount = 1;
+		viewportState.pScissors = nullptr;
+
+		VkDynamicState dynamicStates[ ] = {
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR
+		};
+
+		VkPipelineDynamicStateCreateInfo dynamicState = {};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = 2;
+		dynamicState.pDynamicStates = dynamicStates;
+
+		// Rasterizer
+		VkPipelineRasterizationStateCreateInfo rasterizer = {};
+		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer.depthClampEnable = VK_FALSE;
+		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizer.rasterizerDiscardEnable = VK_FALSE;
+		rasterizer.cullMode = desc.cullMode;
+		rasterizer.lineWidth = 1.0f;
+		rasterizer.frontFace = desc.frontFace;
+		rasterizer.depthBiasEnable = VK_FALSE;
+
+		// Multisampling
+		VkPipelineMultisampleStateCreateInfo multisampling = {};
+		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.sampleShadingEnable = VK_FALSE;
+		multisampling.rasterizationSamples = desc.samples;
+		multisampling.minSampleShading = 1.0f;
+		multisampling.pSampleMask = nullptr;
+		multisampling.alphaToCoverageEnable = VK_FALSE;
+		multisampling.alphaToOneEnable = VK_FALSE;
+
+		// Color blending
+		VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+			VK_COLOR_COMPONENT_G_BIT |
+			VK_COLOR_COMPONENT_B_BIT |
+			VK_COLOR_COMPONENT_A_BIT;
+		colorBlendAttachment.blendEnable = desc.blendMode != BlendMode::Opaque ? VK_TRUE : VK_FALSE;
+		colorBlendAttachment.srcColorBlendFactor = desc.blendMode == BlendMode::Alpha ? VK_BLEND_FACTOR_SRC_ALPHA : VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.dstColorBlendFactor = desc.blendMode == BlendMode::Alpha ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.dstAlphaBlendFactor = desc.blendMode == BlendMode::Alpha ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+		VkPipelineColorBlendStateCreateInfo colorBlending = {};
+		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlending.logicOpEnable = VK_FALSE;
+		colorBlending.logicOp = VK_LOGIC_OP_COPY;
+		colorBlending.attachmentCount = 1;
+		colorBlending.pAttachments = &colorBlendAttachment;
+		colorBlending.blendConstants[0] = 0.0f;
+		colorBlending.blendConstants[1] = 0.0f;
+		colorBlending.blendConstants[2] = 0.0f;
+		colorBlending.blendConstants[3] = 0.0f;
+
+		// Blended variants test against opaque geometry but leave depth alone.
+		// Less-or-equal keeps draw order for the flat scene, where every
+		// fragment is at the same depth.
+		VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencil.depthTestEnable = VK_TRUE;
+		depthStencil.depthWriteEnable = desc.blendMode == BlendMode::Opaque ? VK_TRUE : VK_FALSE;
+		depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		depthStencil.depthBoundsTestEnable = VK_FALSE;
+		depthStencil.stencilTestEnable = VK_FALSE;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.stageCount = 2;
+		pipelineInfo.pStages = shaderStages;
+		pipelineInfo.pVertexInputState = &vertexInputInfo;
+		pipelineInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
+		pipelineInfo.pViewportState = &viewportState;
+		pipelineInfo.pRasterizationState = &rasterizer;
+		pipelineInfo.pMultisampleState = &multisampling;
+		pipelineInfo.pDepthStencilState = &depthStencil;
+		pipelineInfo.pColorBlendState = &colorBlending;
+		pipelineInfo.pDynamicState = &dynamicState;
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.renderPass = renderPass;
+		pipelineInfo.subpass = 0;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineInfo.basePipelineIndex = -1;
+
+		VkPipeline pipeline;
+		if (vkCreateGraphicsPipelines(logicalDevice, pipelineCache, 1, &pipelineInfo, vulkanHostAllocator, &pipeline) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create graphics pipeline!" );
+		}
+
+		return pipeline;
+	}
+
+	void createCullingPipeline()
+	{
+		// instances, draw commands, visible objects
+		VkDescriptorSetLayoutBinding bindings[3] = {};
+		for ( uint32_t i = 0; i < 3; i++ )
+		{
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = 3;
+		layoutInfo.pBindings = bindings;
+
+		if ( vkCreateDescriptorSetLayout( logicalDevice, &layoutInfo, vulkanHostAllocator, &cullingSetLayout ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create descriptor set layout!" );
+		}
+
+		VkPushConstantRange parametersRange = {};
+		parametersRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		parametersRange.offset = 0;
+		parametersRange.size = sizeof( CullingParameters );
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &cullingSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &parametersRange;
+
+		if ( vkCreatePipelineLayout( logicalDevice, &pipelineLayoutInfo, vulkanHostAllocator, &cullingPipelineLayout ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create pipeline layout!" );
+		}
+
+		cullingPipeline = buildComputePipeline( "shaders/cull.spv", cullingPipelineLayout );
+	}
+
+	VkPipeline buildComputePipeline( const std::string &shaderPath, VkPipelineLayout layout )
+	{
+		VkPipelineShaderStageCreateInfo stageInfo = {};
+		stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		stageInfo.module = shaderModules.get( shaderPath );
+		stageInfo.pName = "main";
+
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage = stageInfo;
+		pipelineInfo.layout = layout;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineInfo.basePipelineIndex = -1;
+
+		VkPipeline pipeline;
+		if ( vkCreateComputePipelines( logicalDevice, pipelineCache, 1, &pipelineInfo, vulkanHostAllocator, &pipeline ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create compute pipeline!" );
+		}
+
+		return pipeline;
+	}
+
+	void createUniformRing()
+	{
+		const VkPhysicalDeviceProperties &properties = deviceCapabilities.properties;
+		uniformRing.init( logicalDevice, gpuAllocator, properties.limits.minUniformBufferOffsetAlignment, sizeof( FrameUniforms ), frameSlotCount );
+	}
+
+	void createPipelineCache()
+	{
+		std::vector<char> cacheData;
+
+		std::ifstream file( PIPELINE_CACHE_FILE, std::ios::ate | std::ios::binary );
+		if ( file.is_open() )
+		{
+			size_t fileSize = (size_t) file.tellg();
+			cacheData.resize( fileSize );
+
+			file.seekg( 0 );
+			file.read( cacheData.data(), fileSize );
+			file.close();
+
+			if ( !isPipelineCacheCompatible( cacheData ) )
+			{
+				cacheData.clear();
+			}
+		}
+		else
+		{
+			std::cout << "Pipeline cache: no " << PIPELINE_CACHE_FILE << ", starting cold" << std::endl;
+		}
+
+		VkPipelineCacheCreateInfo cacheCreateInfo = {};
+		cacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheCreateInfo.initialDataSize = cacheData.size();
+		cacheCreateInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+		VkResult result = vkCreatePipelineCache( logicalDevice, &cacheCreateInfo, vulkanHostAllocator, &pipelineCache );
+
+		// The header checks cannot catch a corrupt payload, so give the driver's own
+		// validation a chance to reject it before falling back to an empty cache.
+		if ( result != VK_SUCCESS && !cacheData.empty() )
+		{
+			std::cout << "Pipeline cache: driver rejected " << PIPELINE_CACHE_FILE << ", discarding it" << std::endl;
+
+			cacheData.clear();
+			cacheCreateInfo.initialDataSize = 0;
+			cacheCreateInfo.pInitialData = nullptr;
+			result = vkCreatePipelineCache( logicalDevice, &cacheCreateInfo, vulkanHostAllocator, &pipelineCache );
+		}
+
+		if ( result != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create pipeline cache!" );
+		}
+
+		pipelineCacheLoaded = !cacheData.empty();
+		if ( pipelineCacheLoaded )
+		{
+			std::cout << "Pipeline cache: loaded " << cacheData.size() << " bytes from " << PIPELINE_CACHE_FILE << std::endl;
+		}
+	}
+
+	bool isPipelineCacheCompatible( const std::vector<char> &cacheData )
+	{
+		// A blob written by another driver, device or driver version is useless at
+		// best, so check the header against the device before handing it over.
+		VkPipelineCacheHeaderVersionOne header = {};
+		if ( cacheData.size() < sizeof( header ) )
+		{
+			std::cout << "Pipeline cache: " << PIPELINE_CACHE_FILE << " is truncated, discarding it" << std::endl;
+			return false;
+		}
+		memcpy( &header, cacheData.data(), sizeof( header ) );
+
+		const VkPhysicalDeviceProperties &properties = deviceCapabilities.properties;
+
+		if ( header.headerSize < sizeof( header ) || header.headerSize > cacheData.size() ||
+			 header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE )
+		{
+			std::cout << "Pipeline cache: " << PIPELINE_CACHE_FILE << " has an invalid header, discarding it" << std::endl;
+			return false;
+		}
+
+		if ( header.vendorID != properties.vendorID || header.deviceID != properties.deviceID ||
+			 memcmp( header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE ) != 0 )
+		{
+			std::cout << "Pipeline cache: " << PIPELINE_CACHE_FILE << " was written by another device or driver, discarding it" << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	void savePipelineCache()
+	{
+		size_t dataSize = 0;
+		if ( vkGetPipelineCacheData( logicalDevice, pipelineCache, &dataSize, nullptr ) != VK_SUCCESS || dataSize == 0 )
+		{
+			return;
+		}
+
+		std::vector<char> cacheData( dataSize );
+		if ( vkGetPipelineCacheData( logicalDevice, pipelineCache, &dataSize, cacheData.data() ) != VK_SUCCESS )
+		{
+			return;
+		}
+
+		// Write to a temporary file first so a crash mid-write never leaves a
+		// truncated cache behind for the next launch.
+		std::string tempFile = std::string( PIPELINE_CACHE_FILE ) + ".tmp";
+		std::ofstream file( tempFile, std::ios::binary | std::ios::trunc );
+		if ( !file.is_open() )
+		{
+			std::cerr << "Pipeline cache: could not write " << tempFile << std::endl;
+			return;
+		}
+
+		file.write( cacheData.data(), dataSize );
+		file.close();
+
+		std::remove( PIPELINE_CACHE_FILE );
+		if ( file.fail() || std::rename( tempFile.c_str(), PIPELINE_CACHE_FILE ) != 0 )
+		{
+			std::cerr << "Pipeline cache: could not write " << PIPELINE_CACHE_FILE << std::endl;
+			std::remove( tempFile.c_str() );
+			return;
+		}
+
+		std::cout << "Pipeline cache: saved " << dataSize << " bytes to " << PIPELINE_CACHE_FILE << std::endl;
+	}
+
+	void recreateSwapChain()
+	{
+		// A minimized window has a zero sized framebuffer, wait until it is usable again
+		int width = 0, height = 0;
+		glfwGetFramebufferSize( window, &width, &height );
+		while ( width == 0 || height == 0 )
+		{
+			if ( glfwWindowShouldClose( window ) )
+			{
+				return;
+			}
+			glfwWaitEvents();
+			glfwGetFramebufferSize( window, &width, &height );
+		}
+
+		auto rebuildStart = std::chrono::steady_clock::now();
+		if ( !resizePending )
+		{
+			// Out of date without a resize event, e.g. a display mode change
+			resizePending = true;
+			resizeStartTime = rebuildStart;
+		}
+
+		// Only the extent-dependent objects are rebuilt. The render pass only
+		// depends on the surface format, which does not change for the same
+		// surface, the pipeline uses dynamic viewport and scissor and the command
+		// buffers are recorded every frame anyway.
+		RetiredSwapChain retired = {};
+		retired.swapChain = swapChain;
+		retired.imageViews = std::move( swapChainImageViews );
+		retired.framebuffers = std::move( swapChainFramebuffers );
+		retired.transientImages = std::move( transientImages );
+		retired.retiredAtFrame = frameNumber;
+
+		swapChainImageViews.clear();
+		swapChainFramebuffers.clear();
+		transientImages = {};
+
+		createSwapChain( retired.swapChain );
+		createImageViews();
+		createAttachments();
+		createFrameBuffers();
+
+		// The frames tracked per image belonged to the old images
+		imageFrames.assign( swapChainImages.size(), UINT64_MAX );
+
+		retiredSwapChains.push_back( std::move( retired ) );
+
+		swapChainRebuildMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - rebuildStart ).count();
+		awaitingFirstFrameAfterResize = true;
+	}
+
+	void destroyRetiredSwapChains( bool force )
+	{
+		// Called right after waiting for the current frame slot, at which point
+		// every frame up to frameNumber - frameSlotCount has completed. One
+		// more frame of slack covers the presentation engine still holding the
+		// last image presented from the old swap chain.
+		auto it = retiredSwapChains.begin();
+		while ( it != retiredSwapChains.end() )
+		{
+			if ( !force && frameNumber < it->retiredAtFrame + frameSlotCount )
+			{
+				++it;
+				continue;
+			}
+
+			for ( auto framebuffer : it->framebuffers )
+			{
+				vkDestroyFramebuffer( logicalDevice, framebuffer, vulkanHostAllocator );
+			}
+
+			for ( auto imageView : it->imageViews )
+			{
+				vkDestroyImageView( logicalDevice, imageView, vulkanHostAllocator );
+			}
+
+			transientAllocator.destroy( it->transientImages );
+
+			vkDestroySwapchainKHR( logicalDevice, it->swapChain, vulkanHostAllocator );
+			it = retiredSwapChains.erase( it );
+		}
+	}
+
+	void createSwapChain( VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE )
+	{
+		SwapChainSupportDetails swapChainSupport = surfaceSupport;
+		vkGetPhysicalDeviceSurfaceCapabilitiesKHR( physicalDevice, surface, &swapChainSupport.capabilities );
+
+		VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat( swapChainSupport.formats );
+		VkPresentModeKHR presentMode = chooseSwapPresentMode( swapChainSupport.presentModes );
+		runStatistics.presentMode = presentMode;
+		VkExtent2D extent = chooseSwapExtent( swapChainSupport.capabilities );
+
+		uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+		if ( swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount )
+		{
+			imageCount = swapChainSupport.capabilities.maxImageCount;
+		}
+
+		VkSwapchainCreateInfoKHR swapchainCreateInfo = { };
+		swapchainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+		swapchainCreateInfo.surface = surface;
+
+		// Specify the details of the Swap Chain Images
+		swapchainCreateInfo.minImageCount = imageCount;
+		swapchainCreateInfo.imageFormat = surfaceFormat.format;
+		swapchainCreateInfo.imageColorSpace = surfaceFormat.colorSpace;
+		swapchainCreateInfo.imageExtent = extent;
+		swapchainCreateInfo.imageArrayLayers = 1;
+		swapchainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+		const QueueFamilyIndices &indices = selectedQueueFamilies;
+		uint32_t queueFamilyIndices[ ] = {
+			indices.graphicsFamily.value(),
+			indices.presentFamily.value()
+		};
+
+		if ( indices.graphicsFamily != indices.presentFamily )
+		{
+			swapchainCreateInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+			swapchainCreateInfo.queueFamilyIndexCount = 2;
+			swapchainCreateInfo.pQueueFamilyIndices = queueFamilyIndices;
+		}
+		else
+		{
+			swapchainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			swapchainCreateInfo.queueFamilyIndexCount = 0;
+			swapchainCreateInfo.pQueueFamilyIndices = nullptr;
+		}
+
+		swapchainCreateInfo.preTransform = swapChainSupport.capabilities.currentTransform;
+		swapchainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+		swapchainCreateInfo.presentMode = presentMode;
+		swapchainCreateInfo.clipped = VK_TRUE;
+		// Handing over the old swap chain lets the presentation engine reuse its
+		// resources and keep presenting already queued images without a stall
+		swapchainCreateInfo.oldSwapchain = oldSwapChain;
+
+		if ( vkCreateSwapchainKHR( logicalDevice, &swapchainCreateInfo, vulkanHostAllocator, &swapChain ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create swap chain!" );
+		}
+		
+		vkGetSwapchainImagesKHR( logicalDevice, swapChain, &imageCount, nullptr );
+		swapChainImages.resize( imageCount );
+		vkGetSwapchainImagesKHR( logicalDevice, swapChain, &imageCount, swapChainImages.data() );
+
+		swapChainImageFormat = surfaceFormat.format;
+		swapChainExtent = extent;
+
+	}
+
+	void createOffscreenImages()
+	{
+		// Stand-ins for the swap chain images when running without a window. The rest
+		// of the pipeline only sees the format, extent and views, so render pass,
+		// pipeline and command buffer creation are shared with the windowed path.
+		swapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+		swapChainExtent = { config.width, config.height };
+
+		offscreenImages.resize( HEADLESS_IMAGE_COUNT );
+		offscreenImagesMemory.resize( HEADLESS_IMAGE_COUNT );
+
+		for ( uint32_t i = 0; i < HEADLESS_IMAGE_COUNT; i++ )
+		{
+			VkImageCreateInfo imageInfo = {};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = swapChainImageFormat;
+			imageInfo.extent.width = swapChainExtent.width;
+			imageInfo.extent.height = swapChainExtent.height;
+			imageInfo.extent.depth = 1;
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			if ( vkCreateImage( logicalDevice, &imageInfo, vulkanHostAllocator, &offscreenImages[i] ) != VK_SUCCESS )
+			{
+				throw std::runtime_error( "failed to create offscreen image!" );
+			}
+
+			VkMemoryRequirements memRequirements;
+			vkGetImageMemoryRequirements( logicalDevice, offscreenImages[i], &memRequirements );
+
+			offscreenImagesMemory[i] = gpuAllocator.allocate( memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false );
+			vkBindImageMemory( logicalDevice, offscreenImages[i], offscreenImagesMemory[i].memory, offscreenImagesMemory[i].offset );
+		}
+	}
+
+	void createImageViews()
+	{
+		const std::vector<VkImage> &images = config.headless ? offscreenImages : swapChainImages;
+		swapChainImageViews.resize( images.size() );
+
+		for( size_t i = 0; i < images.size(); i++ )
+		{
+			VkImageViewCreateInfo imageviewCreateInfo = {};
+			imageviewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			imageviewCreateInfo.image = images[i];
+			imageviewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			imageviewCreateInfo.format = swapChainImageFormat;
+			imageviewCreateInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+			imageviewCreateInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+			imageviewCreateInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+			imageviewCreateInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+			imageviewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			imageviewCreateInfo.subresourceRange.baseMipLevel = 0;
+			imageviewCreateInfo.subresourceRange.levelCount = 1;
+			imageviewCreateInfo.subresourceRange.baseArrayLayer = 0;
+			imageviewCreateInfo.subresourceRange.layerCount = 1;
+
+			if (vkCreateImageView(logicalDevice, &imageviewCreateInfo, vulkanHostAllocator, &swapChainImageViews[i]) != VK_SUCCESS )
+			{
+				throw std::runtime_error( "failed to create image views!" );
+			}
+		}
+	}
+
+	void createSurface()
+	{
+		if ( glfwCreateWindowSurface( instance, window, vulkanHostAllocator, &surface ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create window surface!" );
+		}
+	}
+
+	void createLogicalDevice()
+	{
+		// To create a logical device we need to create a VkDeviceCreateInfo*
+		// To create a VkDeviceCreateInfo we first need a VkDeviceQueueCreateInfo*
+		
+		// 1. Get QueueFamilyIndices to pass to queueFamilyIndex attribute,
+		//    chosen along with the device
+		QueueFamilyIndices indices = selectedQueueFamilies;
+
+		// 2. One VkDeviceQueueCreateInfo per distinct family
+		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+		std::set<uint32_t> uniqueFamilies = {
+			indices.graphicsFamily.value(),
+			indices.computeFamily.value(),
+			indices.transferFamily.value()
+		};
+		if ( indices.presentFamily.has_value() )
+		{
+			uniqueFamilies.insert( indices.presentFamily.value() );
+		}
+
+		float queuePriority = 1.0f;
+		for ( uint32_t queueFamily : uniqueFamilies )
+		{
+			VkDeviceQueueCreateInfo queueCreateInfo = { };
+			queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+			queueCreateInfo.queueFamilyIndex = queueFamily;
+			queueCreateInfo.queueCount = 1;
+			queueCreateInfo.pQueuePriorities = &queuePriority;
+			queueCreateInfos.push_back( queueCreateInfo );
+		}
+
+		// Buffers shared between queues only list the families that use buffers
+		uniqueQueueFamilies.assign( uniqueFamilies.begin(), uniqueFamilies.end() );
+		if ( indices.presentFamily.has_value() && indices.presentFamily != indices.graphicsFamily &&
+			indices.presentFamily != indices.computeFamily && indices.presentFamily != indices.transferFamily )
+		{
+			uniqueQueueFamilies.erase( std::find( uniqueQueueFamilies.begin(), uniqueQueueFamilies.end(), indices.presentFamily.value() ) );
+		}
+
+		const VkPhysicalDeviceFeatures &supportedFeatures = deviceCapabilities.features;
+
+		VkPhysicalDeviceFeatures deviceFeatures = { };
+
+		// Every pipeline variant's indirect draw starts at its own first instance,
+		// which needs drawIndirectFirstInstance unless there is only one variant
+		drawMode = config.drawMode;
+		gpuCulling = config.gpuCulling;
+		if ( gpuCulling && drawMode != DrawMode::Indirect )
+		{
+			std::cout << "GPU culling draws indirectly, using indirect draws" << std::endl;
+			drawMode = DrawMode::Indirect;
+		}
+
+		if ( drawMode == DrawMode::Indirect )
+		{
+			if ( supportedFeatures.drawIndirectFirstInstance )
+			{
+				deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+			}
+			else if ( config.pipelineVariants > 1 )
+			{
+				std::cout << "drawIndirectFirstInstance is not supported, using instanced draws" << std::endl;
+				drawMode = DrawMode::Instanced;
+			}
+		}
+
+		// The culling pass runs on the dedicated compute queue when there is one
+		// and otherwise on the graphics queue, just ahead of the render pass
+		const std::vector<VkQueueFamilyProperties> &queueFamilies = deviceCapabilities.queueFamilies;
+		bool computeQueueCompute = ( queueFamilies[indices.computeFamily.value()].queueFlags & VK_QUEUE_COMPUTE_BIT ) != 0;
+		if ( gpuCulling && ( drawMode != DrawMode::Indirect || !computeQueueCompute ) )
+		{
+			std::cout << "GPU culling needs indirect draws and a compute capable queue, culling disabled" << std::endl;
+			gpuCulling = false;
+		}
+		asyncCompute = gpuCulling && indices.computeFamily != indices.graphicsFamily;
+		asyncTransfer = indices.transferFamily != indices.graphicsFamily;
+
+		useTimelineSemaphores = !config.forceFences && supportsTimelineSemaphores( deviceCapabilities );
+		bindlessTextures = config.bindlessTextures && supportsBindlessTextures( deviceCapabilities );
+
+		VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		vulkan12Features.timelineSemaphore = useTimelineSemaphores ? VK_TRUE : VK_FALSE;
+		if ( bindlessTextures )
+		{
+			deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+			vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+			vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+			vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+		}
+
+		VkDeviceCreateInfo deviceCreateInfo = { };
+		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
+		deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
+
+		deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
+		deviceCreateInfo.pNext = useTimelineSemaphores || bindlessTextures ? &vulkan12Features : nullptr;
+
+		std::vector<const char *> requiredDeviceExtensions = getRequiredDeviceExtensions();
+		deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(requiredDeviceExtensions.size());
+		deviceCreateInfo.ppEnabledExtensionNames = requiredDeviceExtensions.data();
+
+		if ( enableValidationLayers )
+		{
+			deviceCreateInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
+			deviceCreateInfo.ppEnabledLayerNames = validationLayers.data();
+		}
+		else
+		{
+			deviceCreateInfo.enabledLayerCount = 0;
+		}
+
+		if ( vkCreateDevice( physicalDevice, &deviceCreateInfo, vulkanHostAllocator, &logicalDevice ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create a logical device!" );
+		}
+
+		if ( useTimelineSemaphores && !timelineFunctions.load( logicalDevice ) )
+		{
+			throw std::runtime_error( "failed to load timeline semaphore functions!" );
+		}
+		std::cout << "Frame synchronization: " << ( useTimelineSemaphores ? "timeline semaphore" : "fences" ) << std::endl;
+		std::cout << "Texture binding: " << ( bindlessTextures ? "bindless (descriptor indexing)" : "per-frame descriptor sets" ) << std::endl;
+
+		vkGetDeviceQueue( logicalDevice, indices.graphicsFamily.value(), 0, &graphicsQueue );
+		if ( indices.presentFamily.has_value() )
+		{
+			vkGetDeviceQueue( logicalDevice, indices.presentFamily.value(), 0, &presentQueue );
+		}
+		vkGetDeviceQueue( logicalDevice, indices.computeFamily.value(), 0, &computeQueue );
+		vkGetDeviceQueue( logicalDevice, indices.transferFamily.value(), 0, &transferQueue );
+
+		auto describeFamily = [&]( uint32_t family )
+		{
+			return std::to_string( family ) + ( family != indices.graphicsFamily.value() ? " (dedicated)" : "" );
+		};
+		std::cout << "Queue families: graphics " << indices.graphicsFamily.value() << ", compute " << describeFamily( indices.computeFamily.value() )
+			<< ", transfer " << describeFamily( indices.transferFamily.value() ) << std::endl;
+	}
+
+	// Scores every device that can run the renderer and picks the highest, or
+	// the one named by the device selector. Each device and the reason it was
+	// rejected or how it scored is logged.
+	void pickPhysicalDevice()
+	{
+		uint32_t physicalDevicesCount = 0;
+		vkEnumeratePhysicalDevices(instance, &physicalDevicesCount, nullptr);
+
+		// If the system does not have a GPU supporting Vulkan, we throw an error
+		if ( physicalDevicesCount == 0 )
+		{
+			throw std::runtime_error( "failed finding GPUs with Vulkan Support" );
+		}
+
+		// Otherwise we populate a VkPhysicalDevice array with the available GPUs
+		std::vector<VkPhysicalDevice> devices( physicalDevicesCount );
+		vkEnumeratePhysicalDevices( instance, &physicalDevicesCount, devices.data() );
+
+		std::string selector = config.deviceSelector;
+		if ( selector.empty() )
+		{
+			const char *variable = std::getenv( DEVICE_OVERRIDE_VARIABLE );
+			selector = variable != nullptr ? variable : "";
+		}
+
+		std::vector<DeviceCapabilities> capabilities = probePhysicalDevices( devices );
+
+		std::vector<DeviceCandidate> candidates( devices.size() );
+		std::vector<QueueFamilyIndices> queueFamilies( devices.size() );
+		std::vector<SwapChainSupportDetails> swapChainSupport( devices.size() );
+		for ( uint32_t i = 0; i < devices.size(); i++ )
+		{
+			DeviceCandidate &candidate = candidates[i];
+			candidate.device = devices[i];
+			candidate.index = i;
+			candidate.properties = capabilities[i].properties;
+			candidate.hasUuid = capabilities[i].hasUuid;
+			memcpy( candidate.uuid, capabilities[i].uuid, VK_UUID_SIZE );
+
+			candidate.rejection = physicalDeviceRejection( capabilities[i], queueFamilies[i], swapChainSupport[i] );
+			if ( candidate.rejection.empty() )
+			{
+				scorePhysicalDevice( candidate, capabilities[i] );
+			}
+
+			std::cout << "GPU " << i << ": " << candidate.properties.deviceName << " (" << deviceTypeName( candidate.properties.deviceType );
+			if ( candidate.hasUuid )
+			{
+				std::cout << ", " << formatDeviceUuid( candidate.uuid );
+			}
+			std::cout << ")";
+			if ( !candidate.rejection.empty() )
+			{
+				std::cout << " rejected: " << candidate.rejection << std::endl;
+				continue;
+			}
+
+			std::cout << " score " << candidate.score << " (";
+			for ( size_t j = 0; j < candidate.scoreReasons.size(); j++ )
+			{
+				std::cout << ( j > 0 ? ", " : "" ) << candidate.scoreReasons[j];
+			}
+			std::cout << ")" << std::endl;
+		}
+
+		const DeviceCandidate *chosen = nullptr;
+		if ( !selector.empty() )
+		{
+			auto match = std::find_if( candidates.begin(), candidates.end(), [&selector]( const DeviceCandidate &candidate ) { return matchesDeviceSelector( selector, candidate ); } );
+			if ( match == candidates.end() )
+			{
+				throw std::runtime_error( "no GPU matches the device selector \"" + selector + "\"!" );
+			}
+			if ( !match->rejection.empty() )
+			{
+				throw std::runtime_error( "selected GPU " + std::string( match->properties.deviceName ) + " is not suitable: " + match->rejection + "!" );
+			}
+			chosen = &*match;
+		}
+		else
+		{
+			for ( const auto &candidate : candidates )
+			{
+				if ( candidate.rejection.empty() && ( chosen == nullptr || candidate.score > chosen->score ) )
+				{
+					chosen = &candidate;
+				}
+			}
+		}
+
+		if ( chosen == nullptr )
+		{
+			throw std::runtime_error( "failed to find a suitable GPU!" );
+		}
+
+		physicalDevice = chosen->device;
+		deviceCapabilities = capabilities[chosen->index];
+		selectedQueueFamilies = queueFamilies[chosen->index];
+		surfaceSupport = swapChainSupport[chosen->index];
+		runStatistics.deviceName = chosen->properties.deviceName;
+		std::cout << "Using " << chosen->properties.deviceName
+			<< ( selector.empty() ? " (highest score)" : " (selected by \"" + selector + "\")" ) << std::endl;
+	}
+
+	// Reads every device's properties, the cache key, and UUID, and takes the
+	// rest from the capability cache when enabled. Devices it does not know are probed
+	// in parallel and added to it.
+	std::vector<DeviceCapabilities> probePhysicalDevices( const std::vector<VkPhysicalDevice> &devices )
+	{
+		if ( config.capabilityCache )
+		{
+			capabilityCache.load( CAPABILITY_CACHE_FILE );
+		}
+
+		std::vector<DeviceCapabilities> capabilities( devices.size() );
+		std::vector<std::future<void>> probes;
+		for ( size_t i = 0; i < devices.size(); i++ )
+		{
+			capabilities[i].device = devices[i];
+			vkGetPhysicalDeviceProperties( devices[i], &capabilities[i].properties );
+			probeDeviceUuid( instance, instanceApiVersion, capabilities[i] );
+
+			if ( !config.capabilityCache || !capabilityCache.find( instanceApiVersion, capabilities[i] ) )
+			{
+				probes.push_back( std::async( std::launch::async, probeDeviceCapabilities, instance, instanceApiVersion, std::ref( capabilities[i] ) ) );
+			}
+		}
+		for ( auto &probe : probes )
+		{
+			probe.get();
+		}
+
+		if ( config.capabilityCache )
+		{
+			for ( const auto &device : capabilities )
+			{
+				if ( !device.fromDiskCache )
+				{
+					capabilityCache.store( instanceApiVersion, device );
+				}
+			}
+			capabilityCache.save( CAPABILITY_CACHE_FILE );
+			capabilityCache.report( std::cout );
+		}
+
+		return capabilities;
+	}
+
+	// The callback only queues the message, the log's thread writes it out
+	void populateDebugMessengerCreateInfo( VkDebugUtilsMessengerCreateInfoEXT &createInfo )
+	{
+		debugMessages.populateCreateInfo( createInfo );
+	}
+
+	void setupDebugMessenger()
+	{
+		if ( !enableValidationLayers )
+		{
+			return;
+		}
+
+		VkDebugUtilsMessengerCreateInfoEXT createInfo;
+		populateDebugMessengerCreateInfo( createInfo );
+
+		if ( CreateDebugUtilsMessengerEXT( instance, &createInfo, vulkanHostAllocator, &debugMessenger ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to set up debug messenger!" );
+		}
+
+	}
+
+	
+
+	void configureFramesInFlight()
+	{
+		framePacer.configure( config.framesInFlight, MAX_FRAMES_IN_FLIGHT, config.adaptiveFramesInFlight );
+		frameSlotCount = config.adaptiveFramesInFlight ? MAX_FRAMES_IN_FLIGHT : framePacer.depth();
+		frameSlotStartTimes.assign( frameSlotCount, std::nullopt );
+
+		std::cout << "Frames in flight: " << framePacer.depth() << ( framePacer.isAdaptive() ? " (adaptive, up to " + std::to_string( frameSlotCount ) + ")" : std::string() ) << std::endl;
+	}
+
+	// Waits until the frame slot about to be reused is free again. The wait is the
+	// CPU blocking on the GPU, which drives the adaptive frames in flight.
+	void beginFrame()
+	{
+		profiler.beginFrame( frameNumber );
+
+		previousFrameStartTime = frameStartTime;
+		frameStartTime = std::chrono::steady_clock::now();
+		frameBlockedMs = 0.0;
+
+		{
+			FrameProfiler::ScopedSpan span( profiler, CpuSpan::WaitForFrameFence );
+			waitForFrame( frameSlotFrames[currentFrame] );
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		frameBlockedMs += std::chrono::duration<double, std::milli>( now - frameStartTime ).count();
+
+		// Input for the previous occupant of this slot was polled right before
+		// its frame started, so this is its input to GPU completion time. It is
+		// exact when the wait blocked and an upper bound otherwise.
+		if ( frameSlotStartTimes[currentFrame] )
+		{
+			framePacer.addLatency( std::chrono::duration<double, std::milli>( now - *frameSlotStartTimes[currentFrame] ).count() );
+		}
+		frameSlotStartTimes[currentFrame] = frameStartTime;
+
+		collectGpuTimestamps( currentFrame );
+		collectCullingCounters( currentFrame );
+
+		// Ring space and pooled buffers of every completed frame can be reused
+		auto frameComplete = [this]( uint64_t frame ) { return isFrameComplete( frame ); };
+		uploadRing.reclaim( frameComplete );
+		streamBufferPool.recycle( frameComplete );
+		uploadRing.beginFrame( frameNumber );
+		textureCache.beginFrame( frameNumber, frameComplete );
+	}
+
+	void waitForImage( uint32_t imageIndex )
+	{
+		if ( !isFrameComplete( imageFrames[imageIndex] ) )
+		{
+			FrameProfiler::ScopedSpan span( profiler, CpuSpan::WaitForImageFence );
+
+			auto waitStart = std::chrono::steady_clock::now();
+			waitForFrame( imageFrames[imageIndex] );
+			frameBlockedMs += std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - waitStart ).count();
+		}
+	}
+
+	void endFrame()
+	{
+		profiler.endFrame();
+		uploadRing.endFrame();
+		if ( config.trackHostAllocations )
+		{
+			hostAllocator.endFrame();
+		}
+		if ( enableValidationLayers )
+		{
+			debugMessages.endFrame();
+		}
+		if ( !startupTimer.isFinished() )
+		{
+			startupTimer.finish( config.headless ? "first frame" : "first frame presented" );
+			startupTimer.report( std::cout );
+			runStatistics.startupMs = startupTimer.totalMs();
+		}
+		frameNumber++;
+
+		double frameMs = frameNumber > 1 ? std::chrono::duration<double, std::milli>( frameStartTime - previousFrameStartTime ).count() : 0.0;
+		if ( frameMs > 0.0 )
+		{
+			runStatistics.frameMs.push_back( frameMs );
+		}
+		if ( framePacer.endFrame( frameMs, frameBlockedMs ) )
+		{
+			// Slots beyond the new depth sit idle until the depth grows again, by
+			// which time their latency sample would be meaningless
+			for ( size_t i = framePacer.depth(); i < frameSlotCount; i++ )
+			{
+				frameSlotStartTimes[i] = std::nullopt;
+			}
+		}
+
+		currentFrame = (currentFrame + 1) % framePacer.depth();
+	}
+
+	void recordFrameCommands( uint32_t imageIndex )
+	{
+		FrameProfiler::ScopedSpan span( profiler, CpuSpan::RecordCommands );
+
+		auto recordStart = std::chrono::steady_clock::now();
+		streamFrameData();
+		updateFrameUniforms();
+		recordCommandBuffer( currentFrame, imageIndex );
+		runStatistics.recordMs += std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - recordStart ).count();
+	}
+
+	void drawOffscreenFrame()
+	{
+		// Same pacing as drawFrame(), but the image index is ours to pick and there
+		// is nothing to acquire from or present to.
+		beginFrame();
+
+		uint32_t imageIndex = nextOffscreenImage;
+		nextOffscreenImage = (nextOffscreenImage + 1) % static_cast<uint32_t>(offscreenImages.size());
+
+		waitForImage( imageIndex );
+
+		recordFrameCommands( imageIndex );
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+
+		submitFrame( submitInfo, imageIndex );
+
+		endFrame();
+	}
+
+	void drawFrame()
+	{
+		if ( config.headless )
+		{
+			drawOffscreenFrame();
+			return;
+		}
+
+		beginFrame();
+		destroyRetiredSwapChains( false );
+
+		uint32_t imageIndex;
+		VkResult result;
+		{
+			FrameProfiler::ScopedSpan span( profiler, CpuSpan::AcquireImage );
+			result = vkAcquireNextImageKHR( logicalDevice, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex );
+		}
+
+		// Nothing has been submitted for this frame yet and the slot is still
+		// free, so it is safe to bail out and retry on the next frame
+		if ( result == VK_ERROR_OUT_OF_DATE_KHR )
+		{
+			frameSlotStartTimes[currentFrame] = std::nullopt;
+			recreateSwapChain();
+			return;
+		}
+		else if ( result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR )
+		{
+			throw std::runtime_error( "failed to acquire swap chain image!" );
+		}
+
+		waitForImage( imageIndex );
+
+		recordFrameCommands( imageIndex );
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+		VkSemaphore waitSemaphores[ ] = { imageAvailableSemaphores[currentFrame] };
+		VkPipelineStageFlags waitStages[ ] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = waitSemaphores;
+		submitInfo.pWaitDstStageMask = waitStages;
+
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+
+		VkSemaphore signalSemaphores[ ] = { renderFinishedSemaphores[currentFrame] };
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = signalSemaphores;
+
+		submitFrame( submitInfo, imageIndex );
+
+		VkPresentInfoKHR presentInfo = {};
+		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pWaitSemaphores = signalSemaphores;
+
+		VkSwapchainKHR swapChains[ ] = { swapChain };
+		presentInfo.swapchainCount = 1;
+		presentInfo.pSwapchains = swapChains;
+
+		presentInfo.pImageIndices = &imageIndex;
+
+		{
+			FrameProfiler::ScopedSpan span( profiler, CpuSpan::QueuePresent );
+			result = vkQueuePresentKHR( presentQueue, &presentInfo );
+		}
+
+		if ( result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR )
+		{
+			throw std::runtime_error( "failed to present swap chain image!" );
+		}
+
+		if ( awaitingFirstFrameAfterResize && result == VK_SUCCESS )
+		{
+			double latencyMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - resizeStartTime ).count();
+			std::cout << "Swap chain resized to " << swapChainExtent.width << "x" << swapChainExtent.height
+				<< ": rebuild " << swapChainRebuildMs << " ms, resize to first frame " << latencyMs << " ms" << std::endl;
+
+			awaitingFirstFrameAfterResize = false;
+			resizePending = false;
+		}
+
+		endFrame();
+
+		if ( result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized )
+		{
+			framebufferResized = false;
+			recreateSwapChain();
+		}
+	}
+	
+
+	
+	// Highest API version both this application and the loader know about. A
+	// 1.0 loader fails instance creation for any apiVersion other than 1.0.
+	uint32_t negotiateApiVersion()
+	{
+		uint32_t loaderVersion = instanceCapabilities.loaderVersion;
+		uint32_t apiVersion = std::min<uint32_t>( VK_MAKE_VERSION( VK_VERSION_MAJOR( loaderVersion ), VK_VERSION_MINOR( loaderVersion ), 0 ), VK_API_VERSION_1_2 );
+		std::cout << "Vulkan loader " << VK_VERSION_MAJOR( loaderVersion ) << "." << VK_VERSION_MINOR( loaderVersion ) << "." << VK_VERSION_PATCH( loaderVersion )
+			<< ", requesting API " << VK_VERSION_MAJOR( apiVersion ) << "." << VK_VERSION_MINOR( apiVersion ) << std::endl;
+
+		return apiVersion;
+	}
+
+	void createInstance()
+	{
+		if ( enableValidationLayers && !checkValidationLayerSupport() )
+		{
+			throw std::runtime_error( "validation layers requested, but not available!" );
+		}
+
+		// 1. Pointer to struct with creation info
+		// 2. Pointer to custom allocator callbacks, vulkanHostAllocator, which is null unless --host-allocator is given
+		// 3. Pointer to the variable that stores the handle to the new intance object
+
+		// Create a VkApplicationInfo structure to pass to the VkInstanceCreateInfo pApplicationInfo
+		VkApplicationInfo appInfo = { };
+		appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+		appInfo.pApplicationName = "Hello Vulkan Triangle";
+		appInfo.applicationVersion = VK_MAKE_VERSION( 1, 0, 0 );
+		appInfo.pEngineName = "None";
+		appInfo.engineVersion = VK_MAKE_VERSION( 1, 0, 0 );
+		instanceApiVersion = negotiateApiVersion();
+		appInfo.apiVersion = instanceApiVersion;
+
+		// Create the VkInstanceCreateInfo structure.
+		VkInstanceCreateInfo createInfo = { };
+		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+		createInfo.pApplicationInfo = &appInfo;
+
+		// You need an extension to interface with the Window System
+		// this is neeeded because Vulkan is a platform independent API
+		// GLFW provides a built-in function to query the extensions it 
+		// needs to do that.
+		/*
+		* uint32_t glfwInstanceExtensionsCount;
+		const char **glfwRequiredExtensions;
+		glfwRequiredExtensions = glfwGetRequiredInstanceExtensions( &glfwInstanceExtensionsCount );
+		createInfo.enabledExtensionCount = glfwInstanceExtensionsCount;
+		createInfo.ppEnabledExtensionNames = glfwRequiredExtensions;
+		*/
+		auto extensions = getRequiredExtensions();
+		createInfo.enabledExtensionCount = static_cast <uint32_t>(extensions.size());
+		createInfo.ppEnabledExtensionNames = extensions.data();
+		
+
+		// The following two members of the struct determine the global validation layers
+		// to enable. If the variable enableValidationLayers is true or false
+		VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo;
+		if ( enableValidationLayers )	// if true (Debug Mode)
+		{
+			createInfo.enabledLayerCount = static_cast<uint32_t> (validationLayers.size());
+			createInfo.ppEnabledLayerNames = validationLayers.data();
+
+			populateDebugMessengerCreateInfo( debugCreateInfo );
+			createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT *) &debugCreateInfo;
+		}
+		else							// if false (Release Mode)
+		{
+			createInfo.enabledLayerCount = 0;
+			createInfo.pNext = nullptr;
+		}
+
+		// 1. vkCreateInstance verifies that the requested layers exist. If not, it will
+		//    return VK_ERROR_LAYER_NOT_PRESENT.
+		// 2. vkCreateInstance verifies that the requested extensions are supported (e.g.
+		//    in the implementation or in any enabled instance layer). If any requested
+		//    extension is not supported, then vkCreateInstance will
+		//    return VK_ERROR_EXTENSION_NOT_PRESENT
+		//
+		// The loader's extensions were enumerated once, by probeInstanceCapabilities(),
+		// so a missing one can be named here
+		for ( const char *extension : extensions )
+		{
+			if ( !instanceCapabilities.hasExtension( extension ) )
+			{
+				throw std::runtime_error( std::string( "instance extension " ) + extension + " is not available!" );
+			}
+		}
+		std::cout << "Instance: " << instanceCapabilities.extensions.size() << " extensions and "
+			<< instanceCapabilities.layers.size() << " layers available" << std::endl;
+
+		// Call the vkCreateInstance() function to createn a Vulkan instance object
+		if ( vkCreateInstance( &createInfo, vulkanHostAllocator, &instance ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create instance!" );
+		}
+	}
+	
+	bool checkValidationLayerSupport()
+	{
+		for ( const char *layerName : validationLayers )
+		{
+			if ( !instanceCapabilities.hasLayer( layerName ) )
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+	
+	bool checkDeviceExtensionSupport( const DeviceCapabilities &capabilities )
+	{
+		for ( const char *extension : getRequiredDeviceExtensions() )
+		{
+			if ( !capabilities.hasExtension( extension ) )
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Why the renderer cannot run on the device, empty when it can. Also fills
+	// in the device's queue families and, with a window, what its surface
+	// supports, for pickPhysicalDevice() to keep if it chooses the device.
+	std::string physicalDeviceRejection( const DeviceCapabilities &capabilities, QueueFamilyIndices &indices, SwapChainSupportDetails &swapChainSupport )
+	{
+		indices = findQueueFamilies( capabilities );
+
+		if ( !indices.graphicsFamily.has_value() )
+		{
+			return "no graphics queue";
+		}
+		if ( !checkDeviceExtensionSupport( capabilities ) )
+		{
+			return "missing required device extensions";
+		}
+		if ( config.headless )
+		{
+			return "";
+		}
+
+		if ( !indices.presentFamily.has_value() )
+		{
+			return "cannot present to the window surface";
+		}
+
+		swapChainSupport = querySwapChainSupport( capabilities.device );
+		if ( swapChainSupport.formats.empty() || swapChainSupport.presentModes.empty() )
+		{
+			return "no surface formats or present modes";
+		}
+
+		return "";
+	}
+
+	VkSurfaceFormatKHR chooseSwapSurfaceFormat( const std::vector<VkSurfaceFormatKHR> &availableFormats )
+	{
+		for ( const auto &availableFormat : availableFormats )
+		{
+			if ( availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR )
+			{
+				return availableFormat;
+			}
+		}
+
+		return availableFormats[0];
+	}
+
+	VkPresentModeKHR chooseSwapPresentMode( const std::vector<VkPresentModeKHR> &availablePresentModes )
+	{
+		if ( config.presentMode )
+		{
+			if ( std::find( availablePresentModes.begin(), availablePresentModes.end(), *config.presentMode ) != availablePresentModes.end() )
+			{
+				return *config.presentMode;
+			}
+
+			// FIFO is the only mode every implementation has to support
+			std::cerr << "present mode " << presentModeName( *config.presentMode ) << " is not supported, using fifo" << std::endl;
+			return VK_PRESENT_MODE_FIFO_KHR;
+		}
+
+		for ( const auto &availablePresentMode : availablePresentModes )
+		{
+			if ( availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR )
+			{
+				return availablePresentMode;
+			}
+		}
+
+		return VK_PRESENT_MODE_FIFO_KHR;
+	}
+
+	VkExtent2D chooseSwapExtent( const VkSurfaceCapabilitiesKHR &capabilities )
+	{
+		if ( capabilities.currentExtent.width != UINT32_MAX )
+		{
+			return capabilities.currentExtent;
+		}
+		else
+		{
+			int width, height;
+			glfwGetFramebufferSize( window, &width, &height );
+
+			VkExtent2D actualExtent = {
+				static_cast<uint32_t>(width),
+				static_cast<uint32_t>(height)
+			};
+
+			actualExtent.width =
+				std::max( capabilities.minImageExtent.width,
+						  std::min( capabilities.maxImageExtent.width,
+									actualExtent.width ) );
+			actualExtent.height =
+				std::max( capabilities.minImageExtent.height,
+						  std::min( capabilities.maxImageExtent.height,
+									actualExtent.height ) );
+
+			return actualExtent;
+		}
+	}
+
+	/*
+		Functions based on structs above
+	*/
+	// Prefers a graphics family that can also present. Compute goes to a family
+	// without graphics and transfer to one with neither graphics nor compute,
+	// so both run alongside the graphics queue. Without such families they
+	// share the graphics family.
+	QueueFamilyIndices findQueueFamilies( const DeviceCapabilities &capabilities )
+	{
+		QueueFamilyIndices indices;
+		const std::vector<VkQueueFamilyProperties> &queueFamilies = capabilities.queueFamilies;
+		uint32_t queueFamiliesCount = static_cast<uint32_t>(queueFamilies.size());
+
+		bool graphicsCanPresent = false;
+		for ( uint32_t i = 0; i < queueFamiliesCount; i++ )
+		{
+			VkQueueFlags flags = queueFamilies[i].queueFlags;
+
+			VkBool32 presentSupport = false;
+			if ( !config.headless )
+			{
+				vkGetPhysicalDeviceSurfaceSupportKHR( capabilities.device, i, surface, &presentSupport );
+				if ( presentSupport && !indices.presentFamily.has_value() )
+				{
+					indices.presentFamily = i;
+				}
+			}
+
+			if ( ( flags & VK_QUEUE_GRAPHICS_BIT ) && ( !indices.graphicsFamily.has_value() || ( presentSupport && !graphicsCanPresent ) ) )
+			{
+				indices.graphicsFamily = i;
+				graphicsCanPresent = presentSupport == VK_TRUE;
+			}
+
+			if ( ( flags & VK_QUEUE_COMPUTE_BIT ) && !( flags & VK_QUEUE_GRAPHICS_BIT ) && !indices.computeFamily.has_value() )
+			{
+				indices.computeFamily = i;
+			}
+
+			if ( ( flags & VK_QUEUE_TRANSFER_BIT ) && !( flags & ( VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT ) ) && !indices.transferFamily.has_value() )
+			{
+				indices.transferFamily = i;
+			}
+		}
+
+		if ( graphicsCanPresent )
+		{
+			indices.presentFamily = indices.graphicsFamily;
+		}
+
+		if ( !config.dedicatedQueues || !indices.computeFamily.has_value() )
+		{
+			indices.computeFamily = indices.graphicsFamily;
+		}
+		if ( !config.dedicatedQueues || !indices.transferFamily.has_value() )
+		{
+			indices.transferFamily = indices.graphicsFamily;
+		}
+
+		return indices;
+	}
+
+	SwapChainSupportDetails querySwapChainSupport( VkPhysicalDevice physicalDevice )
+	{
+		SwapChainSupportDetails details;
+
+		vkGetPhysicalDeviceSurfaceCapabilitiesKHR( physicalDevice, surface, &details.capabilities );
+
+		uint32_t formatCount;
+		vkGetPhysicalDeviceSurfaceFormatsKHR( physicalDevice, surface, &formatCount, nullptr );
+
+		if ( formatCount != 0 )
+		{
+			details.formats.resize( formatCount );
+			vkGetPhysicalDeviceSurfaceFormatsKHR( physicalDevice, surface, &formatCount, details.formats.data() );
+		}
+
+		uint32_t presentModeCount;
+		vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, nullptr);
+
+		if ( presentModeCount != 0 )
+		{
+			details.presentModes.resize( presentModeCount );
+			vkGetPhysicalDeviceSurfacePresentModesKHR( physicalDevice, surface, &presentModeCount, details.presentModes.data() );
+		}
+
+
+		return details;
+	}
+
+	std::vector<const char *> getRequiredExtensions()
+	{
+		std::vector<const char *> extensions;
+
+		// GLFW is never initialized in headless mode and no surface extensions are needed
+		if ( !config.headless )
+		{
+			uint32_t glfwExtensionCount = 0;
+			const char **glfwExtensions;
+			glfwExtensions = glfwGetRequiredInstanceExtensions( &glfwExtensionCount );
+
+			extensions.assign( glfwExtensions, glfwExtensions + glfwExtensionCount );
+		}
+
+		if ( enableValidationLayers )	// if true
+		{
+			extensions.push_back( VK_EXT_DEBUG_UTILS_EXTENSION_NAME );
+		}
+
+		return extensions;
+	}
+
+	std::vector<const char *> getRequiredDeviceExtensions()
+	{
+		if ( config.headless )
+		{
+			return {};
+		}
+
+		return deviceExtensions;
+	}
+};
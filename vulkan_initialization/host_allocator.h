@@ -0,0 +1,391 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+// Allocation callbacks passed to every vkCreate*, vkDestroy*, vkAllocateMemory
+// and vkFreeMemory call, null for the driver's own allocator. Objects must be
+// destroyed with the callbacks they were created with, so this is set before
+// the instance is created and only cleared once it has been destroyed.
+inline const VkAllocationCallbacks *vulkanHostAllocator = nullptr;
+
+inline void *alignedAllocate( size_t size, size_t alignment )
+{
+#ifdef _MSC_VER
+	return _aligned_malloc( size, alignment );
+#else
+	void *memory = nullptr;
+	return posix_memalign( &memory, alignment, size ) == 0 ? memory : nullptr;
+#endif
+}
+
+inline void alignedFree( void *memory )
+{
+#ifdef _MSC_VER
+	_aligned_free( memory );
+#else
+	free( memory );
+#endif
+}
+
+// -------------------------------------------------------------------------------------------------------------------------
+// VkAllocationCallbacks backed by size-class pools, with statistics per
+// VkSystemAllocationScope.
+//
+// Allocations up to MAX_POOLED_SIZE come from power-of-two size classes carved
+// out of CHUNK_SIZE chunks, which are only returned to the system on
+// destroy(). Command scope allocations, which live for at most one command,
+// get their own pools, so their per-frame churn neither fragments nor contends
+// with the long-lived object, cache, device and instance allocations. Larger
+// allocations go straight to the system.
+//
+// Every allocation is preceded by a small header recording its size, scope
+// and size class, so frees and reallocations need no lookup. Thread-safe:
+// drivers call these from whichever thread made the Vulkan call.
+class HostAllocator
+{
+public:
+	static const size_t CHUNK_SIZE = 64 * 1024;
+	static const size_t MAX_POOLED_SIZE = 4096;
+
+	HostAllocator()
+	{
+		callbacks.pUserData = this;
+		callbacks.pfnAllocation = &allocationCallback;
+		callbacks.pfnReallocation = &reallocationCallback;
+		callbacks.pfnFree = &freeCallback;
+		callbacks.pfnInternalAllocation = &internalAllocationCallback;
+		callbacks.pfnInternalFree = &internalFreeCallback;
+	}
+
+	HostAllocator( const HostAllocator & ) = delete;
+	HostAllocator &operator=( const HostAllocator & ) = delete;
+
+	const VkAllocationCallbacks *get() const
+	{
+		return &callbacks;
+	}
+
+	// Returns the pool chunks to the system. Only valid once the instance, and
+	// with it every object created through these callbacks, is gone.
+	void destroy()
+	{
+		int64_t leaked = 0;
+		for ( const auto &stats : scopeStats )
+		{
+			leaked += stats.liveCount.load();
+		}
+		if ( leaked > 0 )
+		{
+			std::cerr << "Host allocator: " << leaked << " allocations still live at shutdown" << std::endl;
+		}
+
+		for ( auto &pools : poolSets )
+		{
+			std::lock_guard<std::mutex> lock( pools.mutex );
+			for ( void *chunk : pools.chunks )
+			{
+				alignedFree( chunk );
+			}
+			pools.chunks.clear();
+			std::fill( std::begin( pools.freeLists ), std::end( pools.freeLists ), nullptr );
+		}
+	}
+
+	// Closes the frame's churn counters. Called once per frame from the main thread.
+	void endFrame()
+	{
+		for ( uint32_t i = 0; i < SCOPE_COUNT; i++ )
+		{
+			uint64_t allocations = scopeStats[i].allocations.load();
+			uint64_t frameAllocations = allocations - frameStartAllocations[i];
+			frameStartAllocations[i] = allocations;
+
+			frameAllocationSums[i] += frameAllocations;
+			peakFrameAllocations[i] = std::max( peakFrameAllocations[i], frameAllocations );
+		}
+		frameCount++;
+	}
+
+	void report( std::ostream &out ) const
+	{
+		static const char *const scopeNames[SCOPE_COUNT] = { "command", "object", "cache", "device", "instance" };
+
+		std::ios::fmtflags flags = out.flags();
+		out << std::fixed << std::setprecision( 1 );
+
+		out << "Host allocations:" << std::endl;
+		for ( uint32_t i = 0; i < SCOPE_COUNT; i++ )
+		{
+			const ScopeStats &stats = scopeStats[i];
+			if ( stats.allocations.load() == 0 && stats.internalAllocations.load() == 0 )
+			{
+				continue;
+			}
+
+			out << "  " << std::left << std::setw( 9 ) << scopeNames[i] << std::right
+				<< stats.liveCount.load() << " live, " << stats.liveBytes.load() / 1024.0 << " KiB (peak "
+				<< stats.peakBytes.load() / 1024.0 << " KiB), " << stats.allocations.load() << " allocations, "
+				<< stats.reallocations.load() << " reallocations, "
+				<< ( frameCount > 0 ? static_cast<double>(frameAllocationSums[i]) / frameCount : 0.0 ) << " per frame (peak "
+				<< peakFrameAllocations[i] << ")";
+			if ( stats.internalAllocations.load() > 0 )
+			{
+				out << ", driver internal " << stats.internalLiveBytes.load() / 1024.0 << " KiB";
+			}
+			out << std::endl;
+		}
+
+		out << "  pools: " << pooledAllocations.load() << " pooled, " << largeAllocations.load() << " large, "
+			<< ( poolSets[0].chunkCount.load() + poolSets[1].chunkCount.load() ) * ( CHUNK_SIZE / 1024 ) << " KiB in chunks" << std::endl;
+		out.flags( flags );
+	}
+
+private:
+	static const uint32_t SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+	// Size classes from 2^MIN_CLASS_SHIFT up to MAX_POOLED_SIZE
+	static const uint32_t MIN_CLASS_SHIFT = 5;
+	static const uint32_t CLASS_COUNT = 8;
+	static const uint8_t LARGE_CLASS = 0xff;
+
+	static const uint8_t TRANSIENT_POOLS = 0;
+	static const uint8_t PERSISTENT_POOLS = 1;
+
+	// Sits right before the pointer handed to the driver. headerSpace is the
+	// distance back to the start of the block, at least sizeof( Header ) and a
+	// multiple of the requested alignment.
+	struct Header
+	{
+		uint64_t size;
+		uint32_t headerSpace;
+		uint8_t sizeClass;
+		uint8_t poolSet;
+		uint8_t scope;
+		uint8_t padding;
+	};
+	static_assert( sizeof( Header ) == 16, "host allocation header must stay 16 bytes" );
+
+	struct ScopeStats
+	{
+		std::atomic<int64_t> liveCount{ 0 };
+		std::atomic<int64_t> liveBytes{ 0 };
+		std::atomic<int64_t> peakBytes{ 0 };
+		std::atomic<uint64_t> allocations{ 0 };
+		std::atomic<uint64_t> reallocations{ 0 };
+		std::atomic<uint64_t> internalAllocations{ 0 };
+		std::atomic<int64_t> internalLiveBytes{ 0 };
+	};
+
+	// Free blocks of each size class form an intrusive list through their first bytes
+	struct PoolSet
+	{
+		std::mutex mutex;
+		void *freeLists[CLASS_COUNT] = {};
+		std::vector<void *> chunks;
+		std::atomic<uint32_t> chunkCount{ 0 };
+	};
+
+	static VKAPI_ATTR void *VKAPI_CALL allocationCallback( void *userData, size_t size, size_t alignment, VkSystemAllocationScope scope )
+	{
+		return static_cast<HostAllocator *>(userData)->allocate( size, alignment, scope );
+	}
+
+	static VKAPI_ATTR void *VKAPI_CALL reallocationCallback( void *userData, void *original, size_t size, size_t alignment, VkSystemAllocationScope scope )
+	{
+		return static_cast<HostAllocator *>(userData)->reallocate( original, size, alignment, scope );
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL freeCallback( void *userData, void *memory )
+	{
+		static_cast<HostAllocator *>(userData)->release( memory );
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL internalAllocationCallback( void *userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope )
+	{
+		ScopeStats &stats = static_cast<HostAllocator *>(userData)->scopeStats[scope];
+		stats.internalAllocations++;
+		stats.internalLiveBytes += static_cast<int64_t>(size);
+	}
+
+	static VKAPI_ATTR void VKAPI_CALL internalFreeCallback( void *userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope )
+	{
+		static_cast<HostAllocator *>(userData)->scopeStats[scope].internalLiveBytes -= static_cast<int64_t>(size);
+	}
+
+	void *allocate( size_t size, size_t alignment, VkSystemAllocationScope scope )
+	{
+		if ( size == 0 )
+		{
+			return nullptr;
+		}
+
+		size_t headerSpace = std::max( alignment, sizeof( Header ) );
+		size_t total = headerSpace + size;
+
+		uint8_t sizeClass = LARGE_CLASS;
+		uint8_t poolSet = scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND ? TRANSIENT_POOLS : PERSISTENT_POOLS;
+		char *block = nullptr;
+
+		// Blocks of a class are aligned to the class size, which covers any
+		// alignment up to it
+		if ( total <= MAX_POOLED_SIZE )
+		{
+			sizeClass = 0;
+			while ( ( size_t( 1 ) << ( MIN_CLASS_SHIFT + sizeClass ) ) < total )
+			{
+				sizeClass++;
+			}
+			block = static_cast<char *>(takeBlock( poolSets[poolSet], sizeClass ));
+			pooledAllocations++;
+		}
+		else
+		{
+			block = static_cast<char *>(alignedAllocate( total, headerSpace ));
+			largeAllocations++;
+		}
+
+		if ( block == nullptr )
+		{
+			return nullptr;
+		}
+
+		char *memory = block + headerSpace;
+		Header *header = reinterpret_cast<Header *>(memory) - 1;
+		header->size = size;
+		header->headerSpace = static_cast<uint32_t>(headerSpace);
+		header->sizeClass = sizeClass;
+		header->poolSet = poolSet;
+		header->scope = static_cast<uint8_t>(scope);
+
+		ScopeStats &stats = scopeStats[scope];
+		stats.allocations++;
+		stats.liveCount++;
+		int64_t liveBytes = stats.liveBytes += static_cast<int64_t>(size);
+		int64_t peak = stats.peakBytes.load();
+		while ( liveBytes > peak && !stats.peakBytes.compare_exchange_weak( peak, liveBytes ) )
+		{
+		}
+
+		return memory;
+	}
+
+	void *reallocate( void *original, size_t size, size_t alignment, VkSystemAllocationScope scope )
+	{
+		if ( original == nullptr )
+		{
+			return allocate( size, alignment, scope );
+		}
+		if ( size == 0 )
+		{
+			release( original );
+			return nullptr;
+		}
+
+		scopeStats[scope].reallocations++;
+
+		// Grow or shrink in place while the pooled block still fits
+		Header *header = static_cast<Header *>(original) - 1;
+		if ( header->sizeClass != LARGE_CLASS && header->scope == scope &&
+			header->headerSpace + size <= ( size_t( 1 ) << ( MIN_CLASS_SHIFT + header->sizeClass ) ) )
+		{
+			ScopeStats &stats = scopeStats[scope];
+			int64_t liveBytes = stats.liveBytes += static_cast<int64_t>(size) - static_cast<int64_t>(header->size);
+			int64_t peak = stats.peakBytes.load();
+			while ( liveBytes > peak && !stats.peakBytes.compare_exchange_weak( peak, liveBytes ) )
+			{
+			}
+			header->size = size;
+			return original;
+		}
+
+		void *memory = allocate( size, alignment, scope );
+		if ( memory != nullptr )
+		{
+			memcpy( memory, original, static_cast<size_t>(std::min<uint64_t>( header->size, size )) );
+			release( original );
+		}
+		return memory;
+	}
+
+	void release( void *memory )
+	{
+		if ( memory == nullptr )
+		{
+			return;
+		}
+
+		Header *header = static_cast<Header *>(memory) - 1;
+		ScopeStats &stats = scopeStats[header->scope];
+		stats.liveCount--;
+		stats.liveBytes -= static_cast<int64_t>(header->size);
+
+		char *block = static_cast<char *>(memory) - header->headerSpace;
+		if ( header->sizeClass == LARGE_CLASS )
+		{
+			alignedFree( block );
+			return;
+		}
+
+		PoolSet &pools = poolSets[header->poolSet];
+		std::lock_guard<std::mutex> lock( pools.mutex );
+		*reinterpret_cast<void **>(block) = pools.freeLists[header->sizeClass];
+		pools.freeLists[header->sizeClass] = block;
+	}
+
+	// Pops a free block of the class, carving a new chunk into blocks when the
+	// list is empty
+	void *takeBlock( PoolSet &pools, uint8_t sizeClass )
+	{
+		std::lock_guard<std::mutex> lock( pools.mutex );
+
+		if ( pools.freeLists[sizeClass] == nullptr )
+		{
+			char *chunk = static_cast<char *>(alignedAllocate( CHUNK_SIZE, MAX_POOLED_SIZE ));
+			if ( chunk == nullptr )
+			{
+				return nullptr;
+			}
+			pools.chunks.push_back( chunk );
+			pools.chunkCount++;
+
+			size_t blockSize = size_t( 1 ) << ( MIN_CLASS_SHIFT + sizeClass );
+			for ( size_t offset = CHUNK_SIZE; offset >= blockSize; offset -= blockSize )
+			{
+				char *block = chunk + offset - blockSize;
+				*reinterpret_cast<void **>(block) = pools.freeLists[sizeClass];
+				pools.freeLists[sizeClass] = block;
+			}
+		}
+
+		void *block = pools.freeLists[sizeClass];
+		pools.freeLists[sizeClass] = *reinterpret_cast<void **>(block);
+		return block;
+	}
+
+	VkAllocationCallbacks callbacks = {};
+
+	PoolSet poolSets[2];
+	ScopeStats scopeStats[SCOPE_COUNT];
+	std::atomic<uint64_t> pooledAllocations{ 0 };
+	std::atomic<uint64_t> largeAllocations{ 0 };
+
+	// Main thread only, see endFrame()
+	uint64_t frameStartAllocations[SCOPE_COUNT] = {};
+	uint64_t frameAllocationSums[SCOPE_COUNT] = {};
+	uint64_t peakFrameAllocations[SCOPE_COUNT] = {};
+	uint64_t frameCount = 0;
+};
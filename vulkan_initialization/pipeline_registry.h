@@ -0,0 +1,285 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "frame_profiler.h"
+#include "host_allocator.h"
+
+enum class BlendMode : uint32_t
+{
+	Opaque,
+	Alpha,
+	Additive
+};
+
+// The fixed-function state that differs between pipeline variants. Everything
+// else (shaders, layout, render pass, dynamic state) is shared by all of them.
+struct PipelineStateDesc
+{
+	VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+	VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+	BlendMode blendMode = BlendMode::Opaque;
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+	bool operator==( const PipelineStateDesc &other ) const
+	{
+		return topology == other.topology && cullMode == other.cullMode && frontFace == other.frontFace &&
+			blendMode == other.blendMode && samples == other.samples;
+	}
+
+	// FNV-1a over the fields one at a time, so struct padding never leaks in
+	uint64_t hash() const
+	{
+		uint64_t value = 14695981039346656037ull;
+		auto mix = [&value]( uint32_t field )
+		{
+			for ( int i = 0; i < 4; i++ )
+			{
+				value ^= ( field >> ( i * 8 ) ) & 0xff;
+				value *= 1099511628211ull;
+			}
+		};
+
+		mix( static_cast<uint32_t>(topology) );
+		mix( static_cast<uint32_t>(cullMode) );
+		mix( static_cast<uint32_t>(frontFace) );
+		mix( static_cast<uint32_t>(blendMode) );
+		mix( static_cast<uint32_t>(samples) );
+		return value;
+	}
+};
+
+struct PipelineStateDescHash
+{
+	size_t operator()( const PipelineStateDesc &desc ) const
+	{
+		return static_cast<size_t>(desc.hash());
+	}
+};
+
+// -------------------------------------------------------------------------------------------------------------------------
+// Owns every graphics pipeline variant, keyed by PipelineStateDesc. Variants
+// are compiled on background threads the first time they are asked for. Until
+// a variant is ready, callers get the fallback pipeline, so the render loop
+// never stalls on a compile. Repeated requests for a variant that is queued or
+// compiling are folded into the pending compile.
+//
+// The build function must be safe to call from several threads at once, which
+// vkCreateGraphicsPipelines is as long as the pipeline cache is not created
+// with VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT.
+class PipelineRegistry
+{
+public:
+	using BuildFunction = std::function<VkPipeline( const PipelineStateDesc & )>;
+
+	void init( VkDevice device, BuildFunction build, uint32_t threadCount )
+	{
+		this->device = device;
+		this->build = std::move( build );
+
+		for ( uint32_t i = 0; i < std::max( threadCount, 1u ); i++ )
+		{
+			threads.emplace_back( &PipelineRegistry::compileThreadMain, this );
+		}
+	}
+
+	// Stops the compile threads, dropping variants that have not started
+	// compiling, and destroys every pipeline
+	void destroy()
+	{
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			stopping = true;
+			queue.clear();
+		}
+		workAvailable.notify_all();
+
+		for ( auto &thread : threads )
+		{
+			thread.join();
+		}
+		threads.clear();
+
+		for ( auto &entry : entries )
+		{
+			if ( entry.second.pipeline != VK_NULL_HANDLE )
+			{
+				vkDestroyPipeline( device, entry.second.pipeline, vulkanHostAllocator );
+			}
+		}
+		entries.clear();
+	}
+
+	// Registers a pipeline that was built up front and doubles as the fallback
+	void addFallback( const PipelineStateDesc &desc, VkPipeline pipeline )
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+
+		Entry &entry = entries[desc];
+		entry.state = State::Ready;
+		entry.pipeline = pipeline;
+		fallback = pipeline;
+	}
+
+	// Returns the variant when it is ready and the fallback otherwise, queueing
+	// a compile on first request
+	VkPipeline acquire( const PipelineStateDesc &desc )
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		requestCount++;
+
+		auto it = entries.find( desc );
+		if ( it != entries.end() )
+		{
+			if ( it->second.state == State::Ready )
+			{
+				return it->second.pipeline;
+			}
+
+			if ( it->second.state != State::Failed )
+			{
+				deduplicatedCount++;
+			}
+			return fallback;
+		}
+
+		Entry &entry = entries[desc];
+		entry.state = State::Queued;
+		entry.requestTime = std::chrono::steady_clock::now();
+
+		queue.push_back( desc );
+		maxQueueDepth = std::max( maxQueueDepth, static_cast<uint32_t>(queue.size()) );
+		workAvailable.notify_one();
+
+		return fallback;
+	}
+
+	// Number of variants queued or compiling
+	uint32_t pendingCount()
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		return static_cast<uint32_t>(queue.size()) + compilingCount;
+	}
+
+	void report( std::ostream &out )
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+
+		uint32_t ready = 0;
+		uint32_t failed = 0;
+		for ( const auto &entry : entries )
+		{
+			ready += entry.second.state == State::Ready ? 1 : 0;
+			failed += entry.second.state == State::Failed ? 1 : 0;
+		}
+
+		std::ios::fmtflags flags = out.flags();
+		out << std::fixed << std::setprecision( 3 );
+		out << "Pipeline variants: " << ready << " ready, " << failed << " failed, "
+			<< queue.size() + compilingCount << " pending (max queue depth " << maxQueueDepth << "), "
+			<< requestCount << " requests, " << deduplicatedCount << " deduplicated while pending" << std::endl;
+
+		if ( !compileMs.empty() )
+		{
+			out << "  compile ms p50/p95/max " << FrameProfiler::percentile( compileMs, 0.50 ) << "/"
+				<< FrameProfiler::percentile( compileMs, 0.95 ) << "/" << *std::max_element( compileMs.begin(), compileMs.end() )
+				<< ", request to ready ms p50/p95/max " << FrameProfiler::percentile( readyMs, 0.50 ) << "/"
+				<< FrameProfiler::percentile( readyMs, 0.95 ) << "/" << *std::max_element( readyMs.begin(), readyMs.end() ) << std::endl;
+		}
+		out.flags( flags );
+	}
+
+private:
+	enum class State
+	{
+		Queued,
+		Compiling,
+		Ready,
+		Failed
+	};
+
+	struct Entry
+	{
+		State state = State::Queued;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		std::chrono::steady_clock::time_point requestTime;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	BuildFunction build;
+	VkPipeline fallback = VK_NULL_HANDLE;
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	bool stopping = false;
+
+	std::unordered_map<PipelineStateDesc, Entry, PipelineStateDescHash> entries;
+	std::deque<PipelineStateDesc> queue;
+	uint32_t compilingCount = 0;
+
+	uint64_t requestCount = 0;
+	uint64_t deduplicatedCount = 0;
+	uint32_t maxQueueDepth = 0;
+	std::vector<double> compileMs;
+	std::vector<double> readyMs;
+
+	void compileThreadMain()
+	{
+		for ( ;; )
+		{
+			PipelineStateDesc desc;
+			{
+				std::unique_lock<std::mutex> lock( mutex );
+				workAvailable.wait( lock, [this] { return stopping || !queue.empty(); } );
+				if ( stopping )
+				{
+					return;
+				}
+
+				desc = queue.front();
+				queue.pop_front();
+				entries[desc].state = State::Compiling;
+				compilingCount++;
+			}
+
+			auto compileStart = std::chrono::steady_clock::now();
+
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			try
+			{
+				pipeline = build( desc );
+			}
+			catch ( const std::exception &e )
+			{
+				std::cerr << "pipeline variant " << std::hex << desc.hash() << std::dec << " failed to compile: " << e.what() << std::endl;
+			}
+
+			auto now = std::chrono::steady_clock::now();
+			{
+				std::lock_guard<std::mutex> lock( mutex );
+				Entry &entry = entries[desc];
+				entry.state = pipeline != VK_NULL_HANDLE ? State::Ready : State::Failed;
+				entry.pipeline = pipeline;
+				compilingCount--;
+
+				compileMs.push_back( std::chrono::duration<double, std::milli>( now - compileStart ).count() );
+				readyMs.push_back( std::chrono::duration<double, std::milli>( now - entry.requestTime ).count() );
+			}
+		}
+	}
+};
@@ -0,0 +1,818 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "host_allocator.h"
+
+// How a pass uses an image. Each usage implies the layout the image has to be
+// in and the stages and accesses the barriers around the pass wait for.
+enum class ImageUsage
+{
+	ColorAttachment,	// colour output, read back when blending
+	ResolveAttachment,	// resolve target of the colour attachment with the same index
+	DepthAttachment,	// depth tested and written
+	Sampled				// read from a fragment shader
+};
+
+struct ImageUsageState
+{
+	VkImageLayout layout;
+	VkPipelineStageFlags stages;
+	VkAccessFlags access;
+	VkImageUsageFlags usage;
+	bool writes;
+};
+
+inline ImageUsageState imageUsageState( ImageUsage usage )
+{
+	switch ( usage )
+	{
+	case ImageUsage::ColorAttachment:
+	case ImageUsage::ResolveAttachment:
+		return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true };
+	case ImageUsage::DepthAttachment:
+		return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true };
+	default:
+		return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_USAGE_SAMPLED_BIT, false };
+	}
+}
+
+// -------------------------------------------------------------------------------------------------------------------------
+// Builds the frame from passes that declare which images they write as
+// attachments and which they sample. compile() derives everything that used
+// to be written by hand around the one render pass:
+//
+// - Passes whose output nothing uses are culled. A pass is kept when it writes
+//   an imported image, is marked as having side effects, or writes an image a
+//   kept pass reads.
+// - Every image's layout transitions and the barriers between the passes
+//   that touch it, batched into one vkCmdPipelineBarrier ahead of each pass.
+//   Transient images are shared by every frame in flight, so their first
+//   barrier of a frame waits for their last use in the previous one.
+// - A single-subpass render pass per pass whose attachment layouts match the
+//   barriers, so the render pass itself transitions nothing. An attachment is
+//   only stored when a later pass reads it or it is imported.
+// - The lifetime of each transient image, in pass indices, and the usage
+//   flags it has to be created with, including TRANSIENT_ATTACHMENT when its
+//   contents never leave the pass that writes them.
+// - Once setAliases() says which transient images share memory, the waits
+//   for the previous user of that memory.
+//
+// Images are bound by handle, imported ones every frame before execute().
+class RenderGraph
+{
+public:
+	static const uint32_t NONE = UINT32_MAX;
+
+	void init( VkDevice device )
+	{
+		this->device = device;
+	}
+
+	void destroy()
+	{
+		for ( auto &pass : passes )
+		{
+			if ( pass.renderPass != VK_NULL_HANDLE )
+			{
+				vkDestroyRenderPass( device, pass.renderPass, vulkanHostAllocator );
+				pass.renderPass = VK_NULL_HANDLE;
+			}
+		}
+		passes.clear();
+		images.clear();
+		finalBarriers = {};
+		compiled = false;
+	}
+
+	// An image that outlives the frame, such as a swap chain image. Its
+	// contents on arrival are discarded, writes to it may start once
+	// availableStages are reached, e.g. the stage the acquire semaphore is
+	// waited on. It is left in finalLayout.
+	uint32_t importImage( const std::string &name, VkFormat format, VkImageLayout finalLayout, VkPipelineStageFlags availableStages )
+	{
+		Image image;
+		image.name = name;
+		image.format = format;
+		image.imported = true;
+		image.finalLayout = finalLayout;
+		image.availableStages = availableStages;
+		images.push_back( image );
+		return static_cast<uint32_t>(images.size() - 1);
+	}
+
+	// An image that only holds data within a frame, created by the graph's
+	// user once compile() has worked out its usage
+	uint32_t createImage( const std::string &name, VkFormat format, VkSampleCountFlagBits samples, VkImageAspectFlags aspect )
+	{
+		Image image;
+		image.name = name;
+		image.format = format;
+		image.samples = samples;
+		image.aspect = aspect;
+		images.push_back( image );
+		return static_cast<uint32_t>(images.size() - 1);
+	}
+
+	uint32_t addPass( const std::string &name, std::function<void( VkCommandBuffer )> record )
+	{
+		Pass pass;
+		pass.name = name;
+		pass.record = std::move( record );
+		passes.push_back( std::move( pass ) );
+		return static_cast<uint32_t>(passes.size() - 1);
+	}
+
+	void addColorAttachment( uint32_t pass, uint32_t image, VkAttachmentLoadOp loadOp, VkClearColorValue clearColor )
+	{
+		VkClearValue clearValue = {};
+		clearValue.color = clearColor;
+		addAccess( pass, image, ImageUsage::ColorAttachment, loadOp, clearValue );
+	}
+
+	void addResolveAttachment( uint32_t pass, uint32_t image )
+	{
+		addAccess( pass, image, ImageUsage::ResolveAttachment, VK_ATTACHMENT_LOAD_OP_DONT_CARE, {} );
+	}
+
+	void setDepthAttachment( uint32_t pass, uint32_t image, VkAttachmentLoadOp loadOp, float clearDepth )
+	{
+		VkClearValue clearValue = {};
+		clearValue.depthStencil = { clearDepth, 0 };
+		addAccess( pass, image, ImageUsage::DepthAttachment, loadOp, clearValue );
+	}
+
+	void addSampledImage( uint32_t pass, uint32_t image )
+	{
+		addAccess( pass, image, ImageUsage::Sampled, VK_ATTACHMENT_LOAD_OP_LOAD, {} );
+	}
+
+	// Kept even if nothing reads what it writes
+	void setSideEffects( uint32_t pass )
+	{
+		passes[pass].sideEffects = true;
+	}
+
+	void compile()
+	{
+		if ( compiled )
+		{
+			throw std::runtime_error( "render graph compiled twice!" );
+		}
+
+		cullPasses();
+		computeLifetimes();
+		deriveBarriers();
+		for ( auto &pass : passes )
+		{
+			if ( pass.live )
+			{
+				createRenderPass( pass );
+			}
+		}
+		compiled = true;
+	}
+
+	bool isLive( uint32_t pass ) const
+	{
+		return passes[pass].live;
+	}
+
+	VkRenderPass renderPass( uint32_t pass ) const
+	{
+		return passes[pass].renderPass;
+	}
+
+	// Images in the order a framebuffer for the pass lists their views
+	std::vector<uint32_t> attachments( uint32_t pass ) const
+	{
+		std::vector<uint32_t> result;
+		for ( const auto &access : passes[pass].accesses )
+		{
+			if ( access.usage != ImageUsage::Sampled )
+			{
+				result.push_back( access.image );
+			}
+		}
+		return result;
+	}
+
+	// Usage the image has to be created with, 0 when no kept pass uses it
+	VkImageUsageFlags imageUsage( uint32_t image ) const
+	{
+		return images[image].usage;
+	}
+
+	// First and last kept pass using the image, NONE when none does
+	uint32_t firstUse( uint32_t image ) const
+	{
+		return images[image].firstPass;
+	}
+
+	uint32_t lastUse( uint32_t image ) const
+	{
+		return images[image].lastPass;
+	}
+
+	uint32_t imageCount() const
+	{
+		return static_cast<uint32_t>(images.size());
+	}
+
+	const std::string &imageName( uint32_t image ) const
+	{
+		return images[image].name;
+	}
+
+	bool isImported( uint32_t image ) const
+	{
+		return images[image].imported;
+	}
+
+	VkFormat imageFormat( uint32_t image ) const
+	{
+		return images[image].format;
+	}
+
+	VkSampleCountFlagBits imageSamples( uint32_t image ) const
+	{
+		return images[image].samples;
+	}
+
+	// Transient images that share memory with the image. Whichever ran last,
+	// earlier in the frame or in the previous frame, is waited for and its
+	// writes made available before the image's first use, which discards the
+	// contents. Re-derives the barriers, call it before recording a frame.
+	void setAliases( uint32_t image, const std::vector<uint32_t> &aliases )
+	{
+		images[image].aliases = aliases;
+		if ( compiled )
+		{
+			deriveBarriers();
+		}
+	}
+
+	VkImageView imageView( uint32_t image ) const
+	{
+		return images[image].view;
+	}
+
+	void bindImage( uint32_t image, VkImage handle, VkImageView view )
+	{
+		images[image].image = handle;
+		images[image].view = view;
+	}
+
+	void setFramebuffer( uint32_t pass, VkFramebuffer framebuffer )
+	{
+		passes[pass].framebuffer = framebuffer;
+	}
+
+	void setSubpassContents( uint32_t pass, VkSubpassContents contents )
+	{
+		passes[pass].contents = contents;
+	}
+
+	// Records every kept pass with its barriers, and the final transitions of
+	// the imported images
+	void execute( VkCommandBuffer commandBuffer, VkExtent2D extent )
+	{
+		for ( auto &pass : passes )
+		{
+			if ( !pass.live )
+			{
+				continue;
+			}
+
+			recordBarriers( commandBuffer, pass.barriers );
+
+			if ( pass.renderPass != VK_NULL_HANDLE )
+			{
+				VkRenderPassBeginInfo renderPassInfo = {};
+				renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+				renderPassInfo.renderPass = pass.renderPass;
+				renderPassInfo.framebuffer = pass.framebuffer;
+				renderPassInfo.renderArea.offset = { 0, 0 };
+				renderPassInfo.renderArea.extent = extent;
+				renderPassInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+				renderPassInfo.pClearValues = pass.clearValues.data();
+				vkCmdBeginRenderPass( commandBuffer, &renderPassInfo, pass.contents );
+			}
+
+			pass.record( commandBuffer );
+
+			if ( pass.renderPass != VK_NULL_HANDLE )
+			{
+				vkCmdEndRenderPass( commandBuffer );
+			}
+		}
+
+		recordBarriers( commandBuffer, finalBarriers );
+		executedFrames++;
+	}
+
+	void report( std::ostream &out ) const
+	{
+		uint32_t livePasses = 0;
+		for ( const auto &pass : passes )
+		{
+			livePasses += pass.live ? 1 : 0;
+		}
+
+		out << "Render graph: " << livePasses << " of " << passes.size() << " passes kept, " << barrierCount << " image barriers ("
+			<< layoutTransitionCount << " layout transitions) per frame, " << executedFrames << " frames" << std::endl;
+		for ( const auto &pass : passes )
+		{
+			out << "  " << pass.name << ( pass.live ? "" : " (culled)" );
+			for ( const auto &access : pass.accesses )
+			{
+				out << ( &access == &pass.accesses.front() ? ": " : ", " ) << images[access.image].name << " " << usageName( access.usage );
+				if ( access.usage != ImageUsage::Sampled && pass.live )
+				{
+					out << ( access.store ? " stored" : " discarded" );
+				}
+			}
+			out << std::endl;
+		}
+	}
+
+private:
+	struct Image
+	{
+		std::string name;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+		VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+		bool imported = false;
+		VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags availableStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+		// Derived by compile()
+		VkImageUsageFlags usage = 0;
+		uint32_t firstPass = NONE;
+		uint32_t lastPass = NONE;
+
+		std::vector<uint32_t> aliases;
+
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+	};
+
+	struct Access
+	{
+		uint32_t image;
+		ImageUsage usage;
+		VkAttachmentLoadOp loadOp;
+		VkClearValue clearValue;
+		bool store = false;	// derived, attachments only
+	};
+
+	struct Barrier
+	{
+		uint32_t image;
+		VkImageLayout oldLayout;
+		VkImageLayout newLayout;
+		VkAccessFlags srcAccess;
+		VkAccessFlags dstAccess;
+	};
+
+	struct BarrierBatch
+	{
+		std::vector<Barrier> barriers;
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		std::function<void( VkCommandBuffer )> record;
+		std::vector<Access> accesses;
+		bool sideEffects = false;
+
+		// Derived by compile()
+		bool live = false;
+		BarrierBatch barriers;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		std::vector<VkClearValue> clearValues;
+
+		// Set per frame
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+		VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE;
+	};
+
+	// Where an image was left, for the next barrier on it
+	struct ImageState
+	{
+		VkImageLayout layout;
+		VkPipelineStageFlags stages;
+		VkAccessFlags writeAccess;	// accesses a later use has to wait for
+		VkPipelineStageFlags readStages;	// reads since the last write, a later write waits for them
+	};
+
+	static const char *usageName( ImageUsage usage )
+	{
+		switch ( usage )
+		{
+		case ImageUsage::ColorAttachment:
+			return "colour";
+		case ImageUsage::ResolveAttachment:
+			return "resolve";
+		case ImageUsage::DepthAttachment:
+			return "depth";
+		default:
+			return "sampled";
+		}
+	}
+
+	void addAccess( uint32_t pass, uint32_t image, ImageUsage usage, VkAttachmentLoadOp loadOp, VkClearValue clearValue )
+	{
+		for ( const auto &access : passes[pass].accesses )
+		{
+			if ( access.image == image )
+			{
+				throw std::runtime_error( "render graph pass " + passes[pass].name + " uses " + images[image].name + " twice!" );
+			}
+		}
+
+		Access access;
+		access.image = image;
+		access.usage = usage;
+		access.loadOp = loadOp;
+		access.clearValue = clearValue;
+		passes[pass].accesses.push_back( access );
+	}
+
+	// Whether the access needs what the image held before the pass
+	static bool readsContents( const Access &access )
+	{
+		return access.usage == ImageUsage::Sampled || access.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD;
+	}
+
+	void cullPasses()
+	{
+		std::vector<bool> needed( images.size(), false );
+		for ( size_t i = passes.size(); i-- > 0; )
+		{
+			Pass &pass = passes[i];
+			pass.live = pass.sideEffects;
+			for ( const auto &access : pass.accesses )
+			{
+				if ( imageUsageState( access.usage ).writes && ( images[access.image].imported || needed[access.image] ) )
+				{
+					pass.live = true;
+				}
+			}
+
+			if ( pass.live )
+			{
+				for ( const auto &access : pass.accesses )
+				{
+					if ( readsContents( access ) )
+					{
+						needed[access.image] = true;
+					}
+				}
+			}
+		}
+	}
+
+	void computeLifetimes()
+	{
+		for ( uint32_t i = 0; i < passes.size(); i++ )
+		{
+			Pass &pass = passes[i];
+			if ( !pass.live )
+			{
+				continue;
+			}
+
+			for ( auto &access : pass.accesses )
+			{
+				Image &image = images[access.image];
+				image.usage |= imageUsageState( access.usage ).usage;
+				if ( image.firstPass == NONE )
+				{
+					image.firstPass = i;
+				}
+				image.lastPass = i;
+
+				// Stored when a later kept pass needs the contents
+				access.store = image.imported;
+				for ( uint32_t j = i + 1; j < passes.size() && !access.store; j++ )
+				{
+					if ( !passes[j].live )
+					{
+						continue;
+					}
+					for ( const auto &later : passes[j].accesses )
+					{
+						if ( later.image == access.image && readsContents( later ) )
+						{
+							access.store = true;
+						}
+					}
+				}
+			}
+		}
+
+		// Contents that never leave tile memory allow lazily allocated memory
+		for ( uint32_t i = 0; i < images.size(); i++ )
+		{
+			Image &image = images[i];
+			if ( image.imported || image.usage == 0 )
+			{
+				continue;
+			}
+
+			bool stored = false;
+			for ( const auto &pass : passes )
+			{
+				for ( const auto &access : pass.accesses )
+				{
+					stored |= pass.live && access.image == i && ( access.store || access.usage == ImageUsage::Sampled );
+				}
+			}
+			if ( !stored )
+			{
+				image.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+			}
+		}
+	}
+
+	static ImageState stateAfter( const ImageUsageState &usage )
+	{
+		ImageState state;
+		state.layout = usage.layout;
+		state.stages = usage.stages;
+		state.writeAccess = usage.writes ? usage.access & ( VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT ) : 0;
+		state.readStages = usage.writes ? 0 : usage.stages;
+		return state;
+	}
+
+	// How the image was left by its last use in the frame
+	ImageState lastUseState( uint32_t image ) const
+	{
+		ImageState state = { VK_IMAGE_LAYOUT_UNDEFINED, 0, 0, 0 };
+		if ( images[image].lastPass == NONE )
+		{
+			return state;
+		}
+		for ( const auto &access : passes[images[image].lastPass].accesses )
+		{
+			if ( access.image == image )
+			{
+				state = stateAfter( imageUsageState( access.usage ) );
+			}
+		}
+		return state;
+	}
+
+	void deriveBarriers()
+	{
+		// A transient image enters the frame as the previous frame left it
+		// and its aliases as they were last used, with its contents
+		// discarded. An imported one becomes available at its availableStages.
+		std::vector<ImageState> states( images.size() );
+		for ( uint32_t i = 0; i < images.size(); i++ )
+		{
+			const Image &image = images[i];
+			states[i] = { VK_IMAGE_LAYOUT_UNDEFINED, image.availableStages, 0, 0 };
+			if ( image.imported || image.lastPass == NONE )
+			{
+				continue;
+			}
+
+			states[i] = lastUseState( i );
+			for ( uint32_t alias : image.aliases )
+			{
+				ImageState aliasState = lastUseState( alias );
+				states[i].stages |= aliasState.stages;
+				states[i].writeAccess |= aliasState.writeAccess;
+				states[i].readStages |= aliasState.readStages;
+			}
+			states[i].layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		}
+
+		barrierCount = 0;
+		layoutTransitionCount = 0;
+		finalBarriers = {};
+		for ( auto &pass : passes )
+		{
+			if ( !pass.live )
+			{
+				continue;
+			}
+			pass.barriers = {};
+
+			for ( const auto &access : pass.accesses )
+			{
+				ImageUsageState usage = imageUsageState( access.usage );
+				ImageState &state = states[access.image];
+
+				// Reads after reads in the same layout need no barrier
+				if ( !usage.writes && state.writeAccess == 0 && state.layout == usage.layout )
+				{
+					state.readStages |= usage.stages;
+					continue;
+				}
+
+				Barrier barrier;
+				barrier.image = access.image;
+				barrier.oldLayout = state.layout;
+				barrier.newLayout = usage.layout;
+				barrier.srcAccess = state.writeAccess;
+				barrier.dstAccess = usage.access;
+				pass.barriers.barriers.push_back( barrier );
+				pass.barriers.srcStages |= state.stages | state.readStages;
+				pass.barriers.dstStages |= usage.stages;
+				countBarrier( barrier );
+
+				state = stateAfter( usage );
+			}
+		}
+
+		for ( uint32_t i = 0; i < images.size(); i++ )
+		{
+			const Image &image = images[i];
+			if ( !image.imported || image.lastPass == NONE || states[i].layout == image.finalLayout )
+			{
+				continue;
+			}
+
+			Barrier barrier;
+			barrier.image = i;
+			barrier.oldLayout = states[i].layout;
+			barrier.newLayout = image.finalLayout;
+			barrier.srcAccess = states[i].writeAccess;
+			barrier.dstAccess = 0;
+			finalBarriers.srcStages |= states[i].stages | states[i].readStages;
+
+			// Presentation waits on a semaphore, which makes the writes
+			// available, a transfer reads them itself
+			if ( image.finalLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL )
+			{
+				barrier.dstAccess = VK_ACCESS_TRANSFER_READ_BIT;
+				finalBarriers.dstStages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+			}
+			else
+			{
+				finalBarriers.dstStages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+			}
+			finalBarriers.barriers.push_back( barrier );
+			countBarrier( barrier );
+		}
+	}
+
+	void countBarrier( const Barrier &barrier )
+	{
+		barrierCount++;
+		if ( barrier.oldLayout != barrier.newLayout )
+		{
+			layoutTransitionCount++;
+		}
+	}
+
+	void recordBarriers( VkCommandBuffer commandBuffer, const BarrierBatch &batch )
+	{
+		if ( batch.barriers.empty() )
+		{
+			return;
+		}
+
+		imageBarriers.resize( batch.barriers.size() );
+		for ( size_t i = 0; i < batch.barriers.size(); i++ )
+		{
+			const Barrier &barrier = batch.barriers[i];
+			const Image &image = images[barrier.image];
+
+			VkImageMemoryBarrier &imageBarrier = imageBarriers[i];
+			imageBarrier = {};
+			imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageBarrier.srcAccessMask = barrier.srcAccess;
+			imageBarrier.dstAccessMask = barrier.dstAccess;
+			imageBarrier.oldLayout = barrier.oldLayout;
+			imageBarrier.newLayout = barrier.newLayout;
+			imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.image = image.image;
+			imageBarrier.subresourceRange.aspectMask = image.aspect;
+			imageBarrier.subresourceRange.levelCount = 1;
+			imageBarrier.subresourceRange.layerCount = 1;
+		}
+
+		// Images nothing touched before, an empty source scope
+		VkPipelineStageFlags srcStages = batch.srcStages;
+		if ( srcStages == 0 )
+		{
+			srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		}
+		vkCmdPipelineBarrier( commandBuffer, srcStages, batch.dstStages, 0, 0, nullptr, 0, nullptr,
+			static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data() );
+	}
+
+	// Attachments in declaration order, colour and resolve attachments paired
+	// by index. Initial and final layouts equal the subpass layouts, the
+	// graph's barriers do every transition.
+	void createRenderPass( Pass &pass )
+	{
+		std::vector<VkAttachmentDescription> descriptions;
+		std::vector<VkAttachmentReference> colorReferences;
+		std::vector<VkAttachmentReference> resolveReferences;
+		VkAttachmentReference depthReference = {};
+		bool hasDepth = false;
+
+		for ( const auto &access : pass.accesses )
+		{
+			if ( access.usage == ImageUsage::Sampled )
+			{
+				continue;
+			}
+
+			const Image &image = images[access.image];
+			VkImageLayout layout = imageUsageState( access.usage ).layout;
+
+			VkAttachmentDescription description = {};
+			description.format = image.format;
+			description.samples = image.samples;
+			description.loadOp = access.loadOp;
+			description.storeOp = access.store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			description.initialLayout = layout;
+			description.finalLayout = layout;
+
+			VkAttachmentReference reference = {};
+			reference.attachment = static_cast<uint32_t>(descriptions.size());
+			reference.layout = layout;
+
+			descriptions.push_back( description );
+			pass.clearValues.push_back( access.clearValue );
+
+			switch ( access.usage )
+			{
+			case ImageUsage::ColorAttachment:
+				colorReferences.push_back( reference );
+				break;
+			case ImageUsage::ResolveAttachment:
+				resolveReferences.push_back( reference );
+				break;
+			default:
+				depthReference = reference;
+				hasDepth = true;
+				break;
+			}
+		}
+
+		if ( descriptions.empty() )
+		{
+			return;
+		}
+		if ( !resolveReferences.empty() && resolveReferences.size() != colorReferences.size() )
+		{
+			throw std::runtime_error( "render graph pass " + pass.name + " must resolve every colour attachment or none!" );
+		}
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+		subpass.pColorAttachments = colorReferences.data();
+		subpass.pResolveAttachments = resolveReferences.empty() ? nullptr : resolveReferences.data();
+		subpass.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(descriptions.size());
+		renderPassInfo.pAttachments = descriptions.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+
+		if ( vkCreateRenderPass( device, &renderPassInfo, vulkanHostAllocator, &pass.renderPass ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create render pass for " + pass.name + "!" );
+		}
+	}
+
+	VkDevice device = VK_NULL_HANDLE;
+	std::vector<Image> images;
+	std::vector<Pass> passes;
+	BarrierBatch finalBarriers;
+	bool compiled = false;
+
+	// Reused by every recordBarriers() call
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+
+	uint32_t barrierCount = 0;
+	uint32_t layoutTransitionCount = 0;
+	uint64_t executedFrames = 0;
+};
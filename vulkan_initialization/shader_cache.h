@@ -0,0 +1,264 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "host_allocator.h"
+
+// -------------------------------------------------------------------------------------------------------------------------
+// Read-only memory mapping of a whole file. The mapping starts on a page
+// boundary, so its contents are suitably aligned for any word-sized access.
+class MappedFile
+{
+public:
+	explicit MappedFile( const std::string &path )
+	{
+#ifdef _WIN32
+		file = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+		if ( file == INVALID_HANDLE_VALUE )
+		{
+			throw std::runtime_error( "failed to open file " + path + "!" );
+		}
+
+		LARGE_INTEGER fileSize;
+		GetFileSizeEx( file, &fileSize );
+		size = static_cast<size_t>(fileSize.QuadPart);
+
+		if ( size > 0 )
+		{
+			mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+			data = mapping ? MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) : nullptr;
+			if ( data == nullptr )
+			{
+				close();
+				throw std::runtime_error( "failed to map file " + path + "!" );
+			}
+		}
+#else
+		fd = open( path.c_str(), O_RDONLY );
+		if ( fd < 0 )
+		{
+			throw std::runtime_error( "failed to open file " + path + "!" );
+		}
+
+		struct stat status;
+		fstat( fd, &status );
+		size = static_cast<size_t>(status.st_size);
+
+		if ( size > 0 )
+		{
+			data = mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+			if ( data == MAP_FAILED )
+			{
+				data = nullptr;
+				close();
+				throw std::runtime_error( "failed to map file " + path + "!" );
+			}
+		}
+#endif
+	}
+
+	~MappedFile()
+	{
+		close();
+	}
+
+	MappedFile( const MappedFile & ) = delete;
+	MappedFile &operator=( const MappedFile & ) = delete;
+
+	const void *bytes() const
+	{
+		return data;
+	}
+
+	size_t byteSize() const
+	{
+		return size;
+	}
+
+private:
+	void *data = nullptr;
+	size_t size = 0;
+
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+
+	void close()
+	{
+		if ( data )
+		{
+			UnmapViewOfFile( data );
+			data = nullptr;
+		}
+		if ( mapping )
+		{
+			CloseHandle( mapping );
+			mapping = nullptr;
+		}
+		if ( file != INVALID_HANDLE_VALUE )
+		{
+			CloseHandle( file );
+			file = INVALID_HANDLE_VALUE;
+		}
+	}
+#else
+	int fd = -1;
+
+	void close()
+	{
+		if ( data )
+		{
+			munmap( data, size );
+			data = nullptr;
+		}
+		if ( fd >= 0 )
+		{
+			::close( fd );
+			fd = -1;
+		}
+	}
+#endif
+};
+
+// -------------------------------------------------------------------------------------------------------------------------
+// Creates each VkShaderModule once. SPIR-V files are memory mapped and handed
+// to vkCreateShaderModule in place, which copies the code, so nothing is read
+// into an intermediate buffer. Modules are keyed by a hash of the SPIR-V, so
+// identical code reached through different paths shares one module, and the
+// path of every file loaded so far is remembered so later lookups skip the
+// file system entirely.
+//
+// Safe to call from the pipeline compile threads.
+class ShaderModuleCache
+{
+public:
+	void init( VkDevice device )
+	{
+		this->device = device;
+	}
+
+	void destroy()
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+
+		for ( const auto &module : modules )
+		{
+			vkDestroyShaderModule( device, module.second, vulkanHostAllocator );
+		}
+		modules.clear();
+		paths.clear();
+	}
+
+	VkShaderModule get( const std::string &path )
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+
+		auto pathIt = paths.find( path );
+		if ( pathIt != paths.end() )
+		{
+			pathHits++;
+			return modules[pathIt->second];
+		}
+
+		MappedFile file( path );
+		const uint32_t *code = static_cast<const uint32_t *>(file.bytes());
+		validateSpirv( path, code, file.byteSize() );
+
+		uint64_t hash = hashWords( code, file.byteSize() / sizeof( uint32_t ) );
+		paths[path] = hash;
+
+		auto moduleIt = modules.find( hash );
+		if ( moduleIt != modules.end() )
+		{
+			contentHits++;
+			return moduleIt->second;
+		}
+
+		VkShaderModuleCreateInfo shaderCreateInfo = {};
+		shaderCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		shaderCreateInfo.codeSize = file.byteSize();
+		shaderCreateInfo.pCode = code;
+
+		VkShaderModule shaderModule;
+		if ( vkCreateShaderModule( device, &shaderCreateInfo, vulkanHostAllocator, &shaderModule ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create shader module!" );
+		}
+
+		modulesCreated++;
+		modules[hash] = shaderModule;
+		return shaderModule;
+	}
+
+	void report( std::ostream &out )
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		out << "Shader modules: " << modulesCreated << " created, " << pathHits << " path hits, "
+			<< contentHits << " identical SPIR-V reused" << std::endl;
+	}
+
+private:
+	static const uint32_t SPIRV_MAGIC = 0x07230203;
+	static const size_t SPIRV_HEADER_WORDS = 5;
+
+	VkDevice device = VK_NULL_HANDLE;
+	std::mutex mutex;
+	std::unordered_map<uint64_t, VkShaderModule> modules;
+	std::unordered_map<std::string, uint64_t> paths;
+
+	uint64_t modulesCreated = 0;
+	uint64_t pathHits = 0;
+	uint64_t contentHits = 0;
+
+	static void validateSpirv( const std::string &path, const uint32_t *code, size_t size )
+	{
+		if ( size < SPIRV_HEADER_WORDS * sizeof( uint32_t ) || size % sizeof( uint32_t ) != 0 )
+		{
+			throw std::runtime_error( path + " is not a whole number of SPIR-V words!" );
+		}
+
+		if ( reinterpret_cast<uintptr_t>(code) % alignof( uint32_t ) != 0 )
+		{
+			throw std::runtime_error( path + " is not mapped at a 4 byte aligned address!" );
+		}
+
+		// glslc writes host-endian SPIR-V, so a byte-swapped magic means the file
+		// came from a machine of the other endianness
+		if ( code[0] != SPIRV_MAGIC )
+		{
+			throw std::runtime_error( path + " does not start with the SPIR-V magic number!" );
+		}
+	}
+
+	// FNV-1a, one word at a time
+	static uint64_t hashWords( const uint32_t *words, size_t count )
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for ( size_t i = 0; i < count; i++ )
+		{
+			hash ^= words[i];
+			hash *= 1099511628211ull;
+		}
+		return hash ^ count;
+	}
+};
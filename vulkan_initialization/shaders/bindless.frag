@@ -0,0 +1,20 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+// Every loaded texture, see BindlessDescriptors. The size matches
+// BINDLESS_TEXTURE_CAPACITY, only the slots in use are written.
+layout(set = 1, binding = 0) uniform sampler2D textures[1024];
+
+// Matches DrawConstants, which follows the vertex stage's Camera block
+layout(push_constant) uniform Draw {
+	layout(offset = 12) uint textureIndex;
+} draw;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	outColor = vec4(fragColor * texture(textures[draw.textureIndex], fragTexCoord).rgb, 1.0);
+}
\ No newline at end of file
@@ -1,3 +1,5 @@
 C:/VulkanSDK/1.2.154.1/Bin32/glslc.exe shader.vert -o vert.spv
 C:/VulkanSDK/1.2.154.1/Bin32/glslc.exe shader.frag -o frag.spv
+C:/VulkanSDK/1.2.154.1/Bin32/glslc.exe cull.comp -o cull.spv
+C:/VulkanSDK/1.2.154.1/Bin32/glslc.exe bindless.frag -o bindless.spv
 pause
\ No newline at end of file
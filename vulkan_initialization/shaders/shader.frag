@@ -2,9 +2,13 @@
 #extension GL_ARB_separate_shader_objects : enable
 
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+// The texture on screen, a white texel when there is none
+layout(set = 0, binding = 2) uniform sampler2D texSampler;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-	outColor = vec4(fragColor, 1.0);
+	outColor = vec4(fragColor * texture(texSampler, fragTexCoord).rgb, 1.0);
 }
\ No newline at end of file
@@ -1,21 +1,52 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec4 inColor;
+
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+// One per object. Matches InstanceData.
+struct Instance {
+	vec2 offset;
+	float scale;
+	uint variant;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Instances {
+	Instance instances[];
+};
+
+// The object drawn by each instance, the output of cull.comp when culling
+layout(std430, set = 0, binding = 1) readonly buffer ObjectIndices {
+	uint objectIndices[];
+};
 
-vec2 positions[3] = vec2[](
-	vec2(0.0, -0.5),
-	vec2(0.5, 0.5),
-	vec2(-0.5, 0.5)
-);
+// Matches FrameUniforms, at the frame slot's dynamic offset
+layout(std140, set = 0, binding = 3) uniform Frame {
+	float time;
+	float motionAmplitude;
+} frame;
 
-vec3 colors[3] = vec3[](
-	vec3(1.0, 0.0, 0.0),
-	vec3(0.0, 1.0, 0.0),
-	vec3(0.0, 0.0, 1.0)
-);
+// Matches CameraData
+layout(push_constant) uniform Camera {
+	vec2 offset;
+	float zoom;
+} camera;
 
 void main() {
-	gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-	fragColor = colors[gl_VertexIndex];
+	uint object = objectIndices[gl_InstanceIndex];
+	Instance instance = instances[object];
+
+	// Each object circles its offset, out of phase with its neighbours
+	float phase = frame.time + float(object) * 0.7;
+	vec2 motion = frame.motionAmplitude * vec2(cos(phase), sin(phase));
+
+	vec2 position = (inPosition + motion) * instance.scale + instance.offset;
+	gl_Position = vec4((position - camera.offset) * camera.zoom, 0.0, 1.0);
+	fragColor = inColor.rgb;
+
+	// The mesh spans [-1, 1], which maps onto the texture once
+	fragTexCoord = inPosition * 0.5 + 0.5;
 }
\ No newline at end of file
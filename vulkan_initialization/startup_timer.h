@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// -------------------------------------------------------------------------------------------------------------------------
+// Wall clock time of each startup phase, from the start of run() to the
+// first presented frame. Each mark() closes the phase that began at the
+// previous mark.
+class StartupTimer
+{
+public:
+	void start()
+	{
+		startTime = std::chrono::steady_clock::now();
+		lastMark = startTime;
+		phases.clear();
+		finished = false;
+	}
+
+	void mark( const char *phase )
+	{
+		if ( finished )
+		{
+			return;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		phases.push_back( { phase, std::chrono::duration<double, std::milli>( now - lastMark ).count() } );
+		lastMark = now;
+	}
+
+	// Closes the last phase, later marks are ignored
+	void finish( const char *phase )
+	{
+		mark( phase );
+		finished = true;
+	}
+
+	bool isFinished() const
+	{
+		return finished;
+	}
+
+	double totalMs() const
+	{
+		return std::chrono::duration<double, std::milli>( lastMark - startTime ).count();
+	}
+
+	void report( std::ostream &out ) const
+	{
+		double total = totalMs();
+
+		std::ios::fmtflags flags = out.flags();
+		out << std::fixed << std::setprecision( 2 );
+		out << "Startup: " << total << " ms to first frame" << std::endl;
+		for ( const auto &phase : phases )
+		{
+			out << "  " << std::left << std::setw( 24 ) << phase.name << std::right << std::setw( 9 ) << phase.ms << " ms "
+				<< std::setw( 5 ) << std::setprecision( 1 ) << ( total > 0.0 ? 100.0 * phase.ms / total : 0.0 ) << "%" << std::setprecision( 2 ) << std::endl;
+		}
+		out.flags( flags );
+	}
+
+private:
+	struct Phase
+	{
+		std::string name;
+		double ms;
+	};
+
+	std::chrono::steady_clock::time_point startTime;
+	std::chrono::steady_clock::time_point lastMark;
+	std::vector<Phase> phases;
+	bool finished = false;
+};
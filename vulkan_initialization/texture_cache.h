@@ -0,0 +1,912 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "bindless_descriptors.h"
+#include "frame_profiler.h"
+#include "gpu_allocator.h"
+#include "host_allocator.h"
+#include "upload_ring.h"
+
+// Every texture is uploaded as RGBA8 and sampled as sRGB colour data
+const VkFormat TEXTURE_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+
+// A decoded image, always four bytes per pixel in RGBA order, top row first
+struct DecodedImage
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+};
+
+// Binary (P6) and ASCII (P3) portable pixmaps with 8 bit channels
+inline void decodePpm( const std::vector<uint8_t> &data, DecodedImage &image )
+{
+	size_t position = 0;
+
+	// Header fields are separated by whitespace and may be interleaved with
+	// comments running to the end of the line
+	auto readToken = [&]()
+	{
+		std::string token;
+		while ( position < data.size() )
+		{
+			char c = static_cast<char>(data[position]);
+			if ( c == '#' )
+			{
+				while ( position < data.size() && data[position] != '\n' )
+				{
+					position++;
+				}
+			}
+			else if ( isspace( static_cast<unsigned char>(c) ) )
+			{
+				if ( !token.empty() )
+				{
+					break;
+				}
+				position++;
+			}
+			else
+			{
+				token += c;
+				position++;
+			}
+		}
+		return token;
+	};
+
+	std::string magic = readToken();
+	if ( magic != "P6" && magic != "P3" )
+	{
+		throw std::runtime_error( "failed to decode PPM, only P3 and P6 are supported!" );
+	}
+
+	image.width = static_cast<uint32_t>( std::stoul( readToken() ) );
+	image.height = static_cast<uint32_t>( std::stoul( readToken() ) );
+	if ( std::stoul( readToken() ) != 255 )
+	{
+		throw std::runtime_error( "failed to decode PPM, only 8 bit channels are supported!" );
+	}
+
+	size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+	image.pixels.resize( pixelCount * 4 );
+
+	if ( magic == "P6" )
+	{
+		// Exactly one whitespace character separates the header from the samples
+		position++;
+		if ( data.size() < position + pixelCount * 3 )
+		{
+			throw std::runtime_error( "failed to decode PPM, the file is truncated!" );
+		}
+
+		for ( size_t i = 0; i < pixelCount; i++ )
+		{
+			memcpy( &image.pixels[i * 4], &data[position + i * 3], 3 );
+			image.pixels[i * 4 + 3] = 0xff;
+		}
+		return;
+	}
+
+	for ( size_t i = 0; i < pixelCount; i++ )
+	{
+		for ( int channel = 0; channel < 3; channel++ )
+		{
+			std::string sample = readToken();
+			if ( sample.empty() )
+			{
+				throw std::runtime_error( "failed to decode PPM, the file is truncated!" );
+			}
+			image.pixels[i * 4 + channel] = static_cast<uint8_t>( std::stoul( sample ) );
+		}
+		image.pixels[i * 4 + 3] = 0xff;
+	}
+}
+
+// Uncompressed (type 2) and run-length encoded (type 10) true-colour TGA, 24
+// or 32 bits per pixel
+inline void decodeTga( const std::vector<uint8_t> &data, DecodedImage &image )
+{
+	const size_t HEADER_SIZE = 18;
+	if ( data.size() < HEADER_SIZE )
+	{
+		throw std::runtime_error( "failed to decode TGA, the file is truncated!" );
+	}
+
+	uint8_t idLength = data[0];
+	uint8_t colorMapType = data[1];
+	uint8_t imageType = data[2];
+	uint32_t bytesPerPixel = data[16] / 8;
+	bool topToBottom = ( data[17] & 0x20 ) != 0;
+
+	if ( colorMapType != 0 || ( imageType != 2 && imageType != 10 ) || ( bytesPerPixel != 3 && bytesPerPixel != 4 ) )
+	{
+		throw std::runtime_error( "failed to decode TGA, only 24 and 32 bit true-colour images are supported!" );
+	}
+
+	image.width = data[12] | ( data[13] << 8 );
+	image.height = data[14] | ( data[15] << 8 );
+
+	size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+	image.pixels.resize( pixelCount * 4 );
+
+	size_t position = HEADER_SIZE + idLength;
+
+	// Pixels are stored as BGR(A), bottom row first unless the descriptor says otherwise
+	auto storePixel = [&]( size_t index, const uint8_t *source )
+	{
+		size_t row = index / image.width;
+		size_t column = index % image.width;
+		if ( !topToBottom )
+		{
+			row = image.height - 1 - row;
+		}
+
+		uint8_t *target = &image.pixels[( row * image.width + column ) * 4];
+		target[0] = source[2];
+		target[1] = source[1];
+		target[2] = source[0];
+		target[3] = bytesPerPixel == 4 ? source[3] : 0xff;
+	};
+
+	size_t index = 0;
+	while ( index < pixelCount )
+	{
+		size_t runLength = 1;
+		bool repeated = false;
+		if ( imageType == 10 )
+		{
+			if ( position >= data.size() )
+			{
+				throw std::runtime_error( "failed to decode TGA, the file is truncated!" );
+			}
+			repeated = ( data[position] & 0x80 ) != 0;
+			runLength = ( data[position] & 0x7f ) + 1;
+			position++;
+		}
+
+		size_t sourceBytes = repeated ? bytesPerPixel : runLength * bytesPerPixel;
+		if ( data.size() < position + sourceBytes || index + runLength > pixelCount )
+		{
+			throw std::runtime_error( "failed to decode TGA, the file is truncated!" );
+		}
+
+		for ( size_t i = 0; i < runLength; i++ )
+		{
+			storePixel( index++, &data[position + ( repeated ? 0 : i * bytesPerPixel )] );
+		}
+		position += sourceBytes;
+	}
+}
+
+// Picks the decoder by file extension
+inline void decodeImageFile( const std::string &path, DecodedImage &image )
+{
+	std::ifstream file( path, std::ios::binary );
+	if ( !file )
+	{
+		throw std::runtime_error( "failed to open texture " + path + "!" );
+	}
+	std::vector<uint8_t> data( ( std::istreambuf_iterator<char>( file ) ), std::istreambuf_iterator<char>() );
+
+	std::string extension = path.substr( path.find_last_of( '.' ) + 1 );
+	std::transform( extension.begin(), extension.end(), extension.begin(), []( char c ) { return static_cast<char>(tolower( c )); } );
+
+	if ( extension == "ppm" )
+	{
+		decodePpm( data, image );
+	}
+	else if ( extension == "tga" )
+	{
+		decodeTga( data, image );
+	}
+	else
+	{
+		throw std::runtime_error( "failed to decode " + path + ", unknown image format!" );
+	}
+
+	if ( image.width == 0 || image.height == 0 )
+	{
+		throw std::runtime_error( "failed to decode " + path + ", the image is empty!" );
+	}
+}
+
+// -------------------------------------------------------------------------------------------------------------------------
+// Reference-counted textures, keyed by path. acquire() queues a decode on the
+// cache's background threads. Decoded images are handed to the upload ring on
+// the main thread, as much as fits each frame, and their mip chains are then
+// blitted on the graphics queue by the frame that uploads them.
+//
+// Textures nobody references stay resident until the resident memory exceeds
+// the budget, at which point the least recently used ones are evicted, once
+// the last frame that sampled them has completed. A later acquire() of an
+// evicted texture loads it again.
+//
+// With a BindlessDescriptors table every texture also gets a slot in it for as
+// long as its view exists, see descriptorIndex().
+//
+// Per frame, on the main thread: beginFrame(), acquire/release/view,
+// queueUploads(), then while recording recordCopyBarriers() and
+// recordUploadRelease() on the queue the ring's copies run on, and
+// recordUploadAcquire() and recordMipGeneration() on the graphics queue.
+class TextureCache
+{
+public:
+	using TextureId = uint32_t;
+	static constexpr TextureId INVALID_TEXTURE = UINT32_MAX;
+
+	void init( VkPhysicalDevice physicalDevice, VkDevice device, GpuAllocator &allocator, UploadRing &uploadRing, BindlessDescriptors *bindless,
+		VkDeviceSize budget, uint32_t threadCount )
+	{
+		this->device = device;
+		this->allocator = &allocator;
+		this->uploadRing = &uploadRing;
+		this->bindless = bindless;
+		budgetBytes = budget;
+
+		// Mip chains are blitted with linear filtering, which the format must support
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties( physicalDevice, TEXTURE_FORMAT, &formatProperties );
+		VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		generateMips = ( formatProperties.optimalTilingFeatures & blitFeatures ) == blitFeatures;
+
+		for ( uint32_t i = 0; i < std::max( threadCount, 1u ); i++ )
+		{
+			threads.emplace_back( &TextureCache::decodeThreadMain, this );
+		}
+
+		// A single white texel stands in for textures that are still loading
+		Texture fallbackTexture;
+		fallbackTexture.path = "<fallback>";
+		fallbackTexture.refCount = 1;
+		fallbackTexture.requestTime = std::chrono::steady_clock::now();
+		textures.push_back( fallbackTexture );
+		fallback = 0;
+
+		DecodedTexture white;
+		white.id = fallback;
+		white.image.width = 1;
+		white.image.height = 1;
+		white.image.pixels.assign( 4, 0xff );
+		uploadQueue.push_back( std::move( white ) );
+		queueUploads();
+	}
+
+	void destroy()
+	{
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			stopping = true;
+			decodeQueue.clear();
+		}
+		workAvailable.notify_all();
+
+		for ( auto &thread : threads )
+		{
+			thread.join();
+		}
+		threads.clear();
+
+		for ( auto &texture : textures )
+		{
+			if ( texture.image != VK_NULL_HANDLE )
+			{
+				destroyImage( texture );
+			}
+		}
+		textures.clear();
+
+		for ( auto &entry : samplers )
+		{
+			vkDestroySampler( device, entry.second, vulkanHostAllocator );
+		}
+		samplers.clear();
+	}
+
+	void beginFrame( uint64_t frame, const FrameCompleteFunction &isFrameComplete )
+	{
+		currentFrame = frame;
+		evict( isFrameComplete );
+	}
+
+	TextureId acquire( const std::string &path )
+	{
+		auto it = textureIds.find( path );
+		TextureId id;
+		if ( it == textureIds.end() )
+		{
+			id = static_cast<TextureId>(textures.size());
+			textures.emplace_back();
+			textures[id].path = path;
+			textureIds[path] = id;
+		}
+		else
+		{
+			id = it->second;
+		}
+
+		Texture &texture = textures[id];
+		texture.refCount++;
+		requestCount++;
+
+		if ( texture.state == State::Unloaded )
+		{
+			texture.state = State::Decoding;
+			texture.requestTime = std::chrono::steady_clock::now();
+
+			std::lock_guard<std::mutex> lock( mutex );
+			decodeQueue.push_back( { id, path } );
+			workAvailable.notify_one();
+		}
+		else
+		{
+			hitCount++;
+		}
+		return id;
+	}
+
+	void release( TextureId id )
+	{
+		if ( id != INVALID_TEXTURE && textures[id].refCount > 0 )
+		{
+			textures[id].refCount--;
+		}
+	}
+
+	// The texture's view once its upload has been queued, VK_NULL_HANDLE while
+	// it is loading or when it failed. Marks the texture used by this frame.
+	VkImageView view( TextureId id )
+	{
+		Texture &texture = textures[id];
+		if ( texture.state != State::Uploading && texture.state != State::Resident )
+		{
+			return VK_NULL_HANDLE;
+		}
+		texture.lastUsedFrame = currentFrame;
+		return texture.view;
+	}
+
+	TextureId fallbackTexture() const
+	{
+		return fallback;
+	}
+
+	VkImageView fallbackView()
+	{
+		return view( fallback );
+	}
+
+	// The texture's slot in the bindless table, valid whenever view() is
+	uint32_t descriptorIndex( TextureId id ) const
+	{
+		return textures[id].descriptorIndex;
+	}
+
+	bool isFailed( TextureId id ) const
+	{
+		return textures[id].state == State::Failed;
+	}
+
+	// Samplers are shared by every texture with the same filtering and addressing
+	VkSampler sampler( VkFilter filter, VkSamplerAddressMode addressMode )
+	{
+		uint32_t key = ( static_cast<uint32_t>(filter) << 16 ) | static_cast<uint32_t>(addressMode);
+		auto it = samplers.find( key );
+		if ( it != samplers.end() )
+		{
+			return it->second;
+		}
+
+		VkSamplerCreateInfo samplerInfo = {};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = filter;
+		samplerInfo.minFilter = filter;
+		samplerInfo.mipmapMode = filter == VK_FILTER_LINEAR ? VK_SAMPLER_MIPMAP_MODE_LINEAR : VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = addressMode;
+		samplerInfo.addressModeV = addressMode;
+		samplerInfo.addressModeW = addressMode;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+		samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+
+		VkSampler sampler;
+		if ( vkCreateSampler( device, &samplerInfo, vulkanHostAllocator, &sampler ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create texture sampler!" );
+		}
+		samplers[key] = sampler;
+		return sampler;
+	}
+
+	// Creates the images of decoded textures and queues their level 0 copies in
+	// the upload ring, in decode order, until the ring is full for this frame
+	void queueUploads()
+	{
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			while ( !decoded.empty() )
+			{
+				uploadQueue.push_back( std::move( decoded.front() ) );
+				decoded.pop_front();
+			}
+		}
+
+		while ( !uploadQueue.empty() )
+		{
+			DecodedTexture &next = uploadQueue.front();
+			Texture &texture = textures[next.id];
+
+			if ( !next.error.empty() )
+			{
+				std::cerr << "texture " << texture.path << " failed to load: " << next.error << std::endl;
+				texture.state = State::Failed;
+				failedCount++;
+				uploadQueue.pop_front();
+				continue;
+			}
+
+			VkDeviceSize size = next.image.pixels.size();
+			if ( size > uploadRing->capacity() )
+			{
+				std::cerr << "texture " << texture.path << " failed to load: " << size / 1024 << " KiB does not fit in the upload ring" << std::endl;
+				texture.state = State::Failed;
+				failedCount++;
+				uploadQueue.pop_front();
+				continue;
+			}
+
+			UploadAllocation allocation;
+			if ( !uploadRing->tryAllocate( size, UPLOAD_ALIGNMENT, allocation ) )
+			{
+				deferredCount++;
+				break;
+			}
+			memcpy( allocation.mapped, next.image.pixels.data(), static_cast<size_t>(size) );
+
+			createImage( texture, next.image.width, next.image.height );
+			if ( bindless )
+			{
+				texture.descriptorIndex = bindless->add( texture.view, sampler( VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT ) );
+			}
+
+			VkBufferImageCopy region = {};
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = 0;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = { 0, 0, 0 };
+			region.imageExtent = { next.image.width, next.image.height, 1 };
+			uploadRing->copyToImage( allocation, texture.image, region );
+
+			texture.state = State::Uploading;
+			texture.lastUsedFrame = currentFrame;
+			pendingUploads.push_back( next.id );
+
+			residentBytes += texture.memory.size;
+			peakResidentBytes = std::max( peakResidentBytes, residentBytes );
+			loadedCount++;
+			decodeMs.push_back( next.decodeMs );
+			loadMs.push_back( std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - texture.requestTime ).count() );
+
+			uploadQueue.pop_front();
+		}
+	}
+
+	bool hasPendingUploads() const
+	{
+		return !pendingUploads.empty();
+	}
+
+	// Before the ring's copies: level 0 of every uploaded image becomes a copy
+	// destination. Its old contents are undefined, so the queue running the
+	// copies never has to acquire it.
+	void recordCopyBarriers( VkCommandBuffer commandBuffer )
+	{
+		std::vector<VkImageMemoryBarrier> barriers;
+		for ( TextureId id : pendingUploads )
+		{
+			VkImageMemoryBarrier barrier = imageBarrier( textures[id].image, 0, 1 );
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barriers.push_back( barrier );
+		}
+
+		vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data() );
+	}
+
+	// Release half of the transfer of level 0 from the queue that ran the copies
+	// to the graphics queue, which blits the rest of the chain
+	void recordUploadRelease( VkCommandBuffer commandBuffer, uint32_t transferFamily, uint32_t graphicsFamily )
+	{
+		std::vector<VkImageMemoryBarrier> barriers = ownershipBarriers( transferFamily, graphicsFamily );
+		for ( auto &barrier : barriers )
+		{
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		}
+
+		vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data() );
+	}
+
+	// Acquire half, chained to a semaphore wait at the transfer stage
+	void recordUploadAcquire( VkCommandBuffer commandBuffer, uint32_t transferFamily, uint32_t graphicsFamily )
+	{
+		std::vector<VkImageMemoryBarrier> barriers = ownershipBarriers( transferFamily, graphicsFamily );
+		for ( auto &barrier : barriers )
+		{
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		}
+
+		vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data() );
+	}
+
+	// After the copies, on the graphics queue: blits each level from the one
+	// above it and leaves the whole chain ready for sampling in fragment shaders
+	void recordMipGeneration( VkCommandBuffer commandBuffer )
+	{
+		for ( TextureId id : pendingUploads )
+		{
+			Texture &texture = textures[id];
+			int32_t width = static_cast<int32_t>(texture.width);
+			int32_t height = static_cast<int32_t>(texture.height);
+
+			if ( texture.mipLevels > 1 )
+			{
+				VkImageMemoryBarrier barrier = imageBarrier( texture.image, 1, texture.mipLevels - 1 );
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+					0, nullptr, 0, nullptr, 1, &barrier );
+			}
+
+			for ( uint32_t level = 1; level < texture.mipLevels; level++ )
+			{
+				VkImageMemoryBarrier barrier = imageBarrier( texture.image, level - 1, 1 );
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+					0, nullptr, 0, nullptr, 1, &barrier );
+
+				int32_t nextWidth = std::max( width / 2, 1 );
+				int32_t nextHeight = std::max( height / 2, 1 );
+
+				VkImageBlit blit = {};
+				blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+				blit.srcOffsets[1] = { width, height, 1 };
+				blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+				blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+				vkCmdBlitImage( commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR );
+
+				width = nextWidth;
+				height = nextHeight;
+			}
+
+			// Every level but the last was a blit source
+			VkImageMemoryBarrier barriers[2];
+			uint32_t barrierCount = 0;
+			if ( texture.mipLevels > 1 )
+			{
+				barriers[barrierCount] = imageBarrier( texture.image, 0, texture.mipLevels - 1 );
+				barriers[barrierCount].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+				barriers[barrierCount].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				barrierCount++;
+			}
+			barriers[barrierCount] = imageBarrier( texture.image, texture.mipLevels - 1, 1 );
+			barriers[barrierCount].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barriers[barrierCount].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrierCount++;
+
+			for ( uint32_t i = 0; i < barrierCount; i++ )
+			{
+				barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				barriers[i].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			}
+			vkCmdPipelineBarrier( commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+				0, nullptr, 0, nullptr, barrierCount, barriers );
+
+			texture.state = State::Resident;
+		}
+		pendingUploads.clear();
+	}
+
+	VkDeviceSize getResidentBytes() const
+	{
+		return residentBytes;
+	}
+
+	// Changes whenever views are destroyed, after which descriptors holding
+	// them must be rewritten even if a new view got the same handle
+	uint64_t evictionCount() const
+	{
+		return evictedCount;
+	}
+
+	void report( std::ostream &out ) const
+	{
+		uint32_t resident = 0;
+		for ( const auto &texture : textures )
+		{
+			resident += texture.state == State::Resident ? 1 : 0;
+		}
+
+		std::ios::fmtflags flags = out.flags();
+		out << std::fixed << std::setprecision( 2 );
+		out << "Textures: " << resident << " resident using " << residentBytes / ( 1024.0 * 1024.0 ) << " MiB of a "
+			<< budgetBytes / ( 1024.0 * 1024.0 ) << " MiB budget (peak " << peakResidentBytes / ( 1024.0 * 1024.0 ) << " MiB), "
+			<< requestCount << " requests, " << hitCount << " cache hits, " << loadedCount << " loads, " << evictedCount << " evictions, "
+			<< failedCount << " failed, " << deferredCount << " uploads deferred on a full ring"
+			<< ( generateMips ? "" : ", no mipmaps (format cannot be blitted)" ) << std::endl;
+
+		if ( !loadMs.empty() )
+		{
+			out << "  decode ms p50/p95/max " << FrameProfiler::percentile( decodeMs, 0.50 ) << "/"
+				<< FrameProfiler::percentile( decodeMs, 0.95 ) << "/" << *std::max_element( decodeMs.begin(), decodeMs.end() )
+				<< ", request to upload ms p50/p95/max " << FrameProfiler::percentile( loadMs, 0.50 ) << "/"
+				<< FrameProfiler::percentile( loadMs, 0.95 ) << "/" << *std::max_element( loadMs.begin(), loadMs.end() ) << std::endl;
+		}
+		out.flags( flags );
+	}
+
+private:
+	enum class State
+	{
+		Unloaded,	// never requested or evicted
+		Decoding,
+		Uploading,	// copies and mips recorded by the current frame
+		Resident,
+		Failed
+	};
+
+	struct Texture
+	{
+		std::string path;
+		State state = State::Unloaded;
+		uint32_t refCount = 0;
+		uint64_t lastUsedFrame = UINT64_MAX;
+		std::chrono::steady_clock::time_point requestTime;
+
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		GpuAllocation memory;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mipLevels = 1;
+		uint32_t descriptorIndex = UINT32_MAX;
+	};
+
+	struct DecodeRequest
+	{
+		TextureId id;
+		std::string path;
+	};
+
+	struct DecodedTexture
+	{
+		TextureId id = INVALID_TEXTURE;
+		DecodedImage image;
+		double decodeMs = 0.0;
+		std::string error;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	GpuAllocator *allocator = nullptr;
+	UploadRing *uploadRing = nullptr;
+	BindlessDescriptors *bindless = nullptr;
+	bool generateMips = false;
+
+	// Only touched by the main thread
+	std::vector<Texture> textures;
+	std::unordered_map<std::string, TextureId> textureIds;
+	std::unordered_map<uint32_t, VkSampler> samplers;
+	std::deque<DecodedTexture> uploadQueue;
+	std::vector<TextureId> pendingUploads;
+	TextureId fallback = INVALID_TEXTURE;
+	uint64_t currentFrame = 0;
+
+	// Shared with the decode threads
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	bool stopping = false;
+	std::deque<DecodeRequest> decodeQueue;
+	std::deque<DecodedTexture> decoded;
+
+	VkDeviceSize budgetBytes = 0;
+	VkDeviceSize residentBytes = 0;
+	VkDeviceSize peakResidentBytes = 0;
+	uint64_t requestCount = 0;
+	uint64_t hitCount = 0;
+	uint64_t loadedCount = 0;
+	uint64_t evictedCount = 0;
+	uint64_t failedCount = 0;
+	uint64_t deferredCount = 0;
+	std::vector<double> decodeMs;
+	std::vector<double> loadMs;
+
+	void decodeThreadMain()
+	{
+		for ( ;; )
+		{
+			DecodeRequest request;
+			{
+				std::unique_lock<std::mutex> lock( mutex );
+				workAvailable.wait( lock, [this] { return stopping || !decodeQueue.empty(); } );
+				if ( stopping )
+				{
+					return;
+				}
+
+				request = decodeQueue.front();
+				decodeQueue.pop_front();
+			}
+
+			auto decodeStart = std::chrono::steady_clock::now();
+
+			DecodedTexture result;
+			result.id = request.id;
+			try
+			{
+				decodeImageFile( request.path, result.image );
+			}
+			catch ( const std::exception &e )
+			{
+				result.error = e.what();
+			}
+			result.decodeMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - decodeStart ).count();
+
+			std::lock_guard<std::mutex> lock( mutex );
+			decoded.push_back( std::move( result ) );
+		}
+	}
+
+	// Least recently used first, skipping textures that are referenced or were
+	// sampled by a frame the GPU may still be running
+	void evict( const FrameCompleteFunction &isFrameComplete )
+	{
+		while ( residentBytes > budgetBytes )
+		{
+			Texture *victim = nullptr;
+			for ( auto &texture : textures )
+			{
+				if ( texture.state == State::Resident && texture.refCount == 0 && isFrameComplete( texture.lastUsedFrame ) &&
+					( victim == nullptr || texture.lastUsedFrame < victim->lastUsedFrame ) )
+				{
+					victim = &texture;
+				}
+			}
+
+			if ( victim == nullptr )
+			{
+				return;
+			}
+
+			destroyImage( *victim );
+			victim->state = State::Unloaded;
+			victim->lastUsedFrame = UINT64_MAX;
+			evictedCount++;
+		}
+	}
+
+	void createImage( Texture &texture, uint32_t width, uint32_t height )
+	{
+		texture.width = width;
+		texture.height = height;
+		texture.mipLevels = 1;
+		if ( generateMips )
+		{
+			while ( ( std::max( width, height ) >> texture.mipLevels ) > 0 )
+			{
+				texture.mipLevels++;
+			}
+		}
+
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = TEXTURE_FORMAT;
+		imageInfo.extent = { width, height, 1 };
+		imageInfo.mipLevels = texture.mipLevels;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		if ( vkCreateImage( device, &imageInfo, vulkanHostAllocator, &texture.image ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create texture image!" );
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements( device, texture.image, &memRequirements );
+
+		texture.memory = allocator->allocate( memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false );
+		vkBindImageMemory( device, texture.image, texture.memory.memory, texture.memory.offset );
+
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = texture.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = TEXTURE_FORMAT;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, 1 };
+
+		if ( vkCreateImageView( device, &viewInfo, vulkanHostAllocator, &texture.view ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create texture image view!" );
+		}
+	}
+
+	void destroyImage( Texture &texture )
+	{
+		vkDestroyImageView( device, texture.view, vulkanHostAllocator );
+		vkDestroyImage( device, texture.image, vulkanHostAllocator );
+		residentBytes -= texture.memory.size;
+		allocator->free( texture.memory );
+		texture.view = VK_NULL_HANDLE;
+		texture.image = VK_NULL_HANDLE;
+
+		// Only reached once no in-flight frame can sample the texture
+		if ( texture.descriptorIndex != UINT32_MAX )
+		{
+			bindless->remove( texture.descriptorIndex );
+			texture.descriptorIndex = UINT32_MAX;
+		}
+	}
+
+	static VkImageMemoryBarrier imageBarrier( VkImage image, uint32_t baseMipLevel, uint32_t levelCount )
+	{
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseMipLevel, levelCount, 0, 1 };
+		return barrier;
+	}
+
+	std::vector<VkImageMemoryBarrier> ownershipBarriers( uint32_t srcFamily, uint32_t dstFamily ) const
+	{
+		std::vector<VkImageMemoryBarrier> barriers;
+		for ( TextureId id : pendingUploads )
+		{
+			VkImageMemoryBarrier barrier = imageBarrier( textures[id].image, 0, 1 );
+			barrier.srcQueueFamilyIndex = srcFamily;
+			barrier.dstQueueFamilyIndex = dstFamily;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barriers.push_back( barrier );
+		}
+		return barriers;
+	}
+};
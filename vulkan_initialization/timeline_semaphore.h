@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <stdexcept>
+
+#include "host_allocator.h"
+
+// Vulkan 1.2 entry points used by TimelineSemaphore. They are fetched through
+// vkGetDeviceProcAddr so the application still loads and runs against a 1.0
+// loader that does not export them.
+struct TimelineSemaphoreFunctions
+{
+	PFN_vkWaitSemaphores waitSemaphores = nullptr;
+	PFN_vkGetSemaphoreCounterValue getSemaphoreCounterValue = nullptr;
+
+	bool load( VkDevice device )
+	{
+		waitSemaphores = (PFN_vkWaitSemaphores) vkGetDeviceProcAddr( device, "vkWaitSemaphores" );
+		getSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValue) vkGetDeviceProcAddr( device, "vkGetSemaphoreCounterValue" );
+
+		return waitSemaphores != nullptr && getSemaphoreCounterValue != nullptr;
+	}
+};
+
+// -------------------------------------------------------------------------------------------------------------------------
+// One monotonically increasing counter for all work submitted to a queue. Each
+// submission signals the next value, so "has submission N finished" is a
+// single comparison against the counter instead of a fence per submission.
+//
+// The last value seen on the device is cached: most checks are for work that
+// finished long ago and are answered without calling into the driver at all.
+class TimelineSemaphore
+{
+public:
+	void create( VkDevice device, const TimelineSemaphoreFunctions &functions )
+	{
+		this->device = device;
+		this->functions = &functions;
+
+		VkSemaphoreTypeCreateInfo typeInfo = {};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo = {};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+
+		if ( vkCreateSemaphore( device, &semaphoreInfo, vulkanHostAllocator, &semaphore ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create timeline semaphore!" );
+		}
+
+		lastSubmittedValue = 0;
+		completedValue = 0;
+	}
+
+	void destroy()
+	{
+		if ( semaphore != VK_NULL_HANDLE )
+		{
+			vkDestroySemaphore( device, semaphore, vulkanHostAllocator );
+			semaphore = VK_NULL_HANDLE;
+		}
+	}
+
+	VkSemaphore handle() const
+	{
+		return semaphore;
+	}
+
+	// Reserves the value the next submission will signal
+	uint64_t nextValue()
+	{
+		return ++lastSubmittedValue;
+	}
+
+	uint64_t lastSubmitted() const
+	{
+		return lastSubmittedValue;
+	}
+
+	bool isComplete( uint64_t value )
+	{
+		if ( value <= completedValue )
+		{
+			return true;
+		}
+
+		functions->getSemaphoreCounterValue( device, semaphore, &completedValue );
+		return value <= completedValue;
+	}
+
+	void wait( uint64_t value )
+	{
+		if ( isComplete( value ) )
+		{
+			return;
+		}
+
+		VkSemaphoreWaitInfo waitInfo = {};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &semaphore;
+		waitInfo.pValues = &value;
+
+		if ( functions->waitSemaphores( device, &waitInfo, UINT64_MAX ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to wait for timeline semaphore!" );
+		}
+		completedValue = value;
+	}
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	const TimelineSemaphoreFunctions *functions = nullptr;
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	uint64_t lastSubmittedValue = 0;
+	uint64_t completedValue = 0;
+};
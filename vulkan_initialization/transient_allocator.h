@@ -0,0 +1,325 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "gpu_allocator.h"
+#include "host_allocator.h"
+#include "render_graph.h"
+
+// One of the render graph's transient images and where it lives
+struct TransientImage
+{
+	uint32_t graphImage = RenderGraph::NONE;
+	VkImage image = VK_NULL_HANDLE;
+	VkImageView view = VK_NULL_HANDLE;
+	VkMemoryRequirements requirements = {};
+	uint32_t block = 0;
+	VkDeviceSize offset = 0;	// within the block
+};
+
+// Memory shared by transient images whose lifetimes do not overlap
+struct TransientBlock
+{
+	GpuAllocation allocation;
+	bool lazilyAllocated = false;
+};
+
+// The transient images created for one extent. Retired along with the swap
+// chain on a resize, since frames still in flight use them.
+struct TransientImageSet
+{
+	std::vector<TransientImage> images;
+	std::vector<TransientBlock> blocks;
+	VkDeviceSize unaliasedBytes = 0;	// one allocation per image
+	VkDeviceSize aliasedBytes = 0;	// what the blocks take
+};
+
+// -------------------------------------------------------------------------------------------------------------------------
+// Creates the render graph's transient images and places them in as little
+// memory as their lifetimes allow. Images are placed largest first, each at
+// the lowest offset, in a block of a compatible memory type, that no image
+// alive during any of the same passes occupies. Images that end up sharing
+// memory are handed to RenderGraph::setAliases(), which adds the wait for
+// the memory's previous user to their first barrier.
+//
+// Images whose contents never leave their pass go into lazily allocated
+// memory where the device has it, and only alias each other.
+class TransientAllocator
+{
+public:
+	void init( VkDevice device, GpuAllocator &allocator, bool aliasing )
+	{
+		this->device = device;
+		this->allocator = &allocator;
+		this->aliasing = aliasing;
+	}
+
+	TransientImageSet create( RenderGraph &graph, VkExtent2D extent )
+	{
+		TransientImageSet set;
+		for ( uint32_t i = 0; i < graph.imageCount(); i++ )
+		{
+			if ( graph.isImported( i ) || graph.imageUsage( i ) == 0 )
+			{
+				continue;
+			}
+
+			TransientImage transient;
+			transient.graphImage = i;
+			transient.image = createImage( graph, i, extent );
+			vkGetImageMemoryRequirements( device, transient.image, &transient.requirements );
+			set.unaliasedBytes += transient.requirements.size;
+			set.images.push_back( transient );
+		}
+
+		place( graph, set );
+
+		for ( auto &block : set.blocks )
+		{
+			VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			if ( block.lazilyAllocated )
+			{
+				properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+			}
+			VkMemoryRequirements requirements = blockRequirements[&block - set.blocks.data()];
+			block.allocation = allocator->allocate( requirements, properties, false );
+			set.aliasedBytes += requirements.size;
+		}
+
+		for ( auto &transient : set.images )
+		{
+			const GpuAllocation &allocation = set.blocks[transient.block].allocation;
+			vkBindImageMemory( device, transient.image, allocation.memory, allocation.offset + transient.offset );
+			transient.view = createView( graph, transient );
+			graph.bindImage( transient.graphImage, transient.image, transient.view );
+		}
+
+		// Images sharing memory, the graph makes each wait for the others
+		for ( const auto &transient : set.images )
+		{
+			std::vector<uint32_t> aliases;
+			for ( const auto &other : set.images )
+			{
+				if ( &other != &transient && other.block == transient.block && overlaps( transient.offset, transient.requirements.size, other.offset, other.requirements.size ) )
+				{
+					aliases.push_back( other.graphImage );
+				}
+			}
+			graph.setAliases( transient.graphImage, aliases );
+		}
+
+		return set;
+	}
+
+	void destroy( TransientImageSet &set )
+	{
+		for ( auto &transient : set.images )
+		{
+			vkDestroyImageView( device, transient.view, vulkanHostAllocator );
+			vkDestroyImage( device, transient.image, vulkanHostAllocator );
+		}
+		for ( auto &block : set.blocks )
+		{
+			allocator->free( block.allocation );
+		}
+		set = {};
+	}
+
+	// Each image's size, lifetime and place, and for lazily allocated blocks
+	// how much of their memory the driver actually committed
+	void report( std::ostream &out, const TransientImageSet &set, const RenderGraph &graph ) const
+	{
+		const double MiB = 1024.0 * 1024.0;
+
+		std::ios::fmtflags flags = out.flags();
+		out << std::fixed << std::setprecision( 1 );
+		out << "Transient images: " << set.images.size() << " images, " << set.unaliasedBytes / MiB << " MiB without aliasing, "
+			<< set.aliasedBytes / MiB << " MiB in " << set.blocks.size() << " blocks with" << ( aliasing ? "" : " aliasing disabled" );
+		if ( set.unaliasedBytes > 0 )
+		{
+			out << " (" << 100.0 * ( static_cast<double>(set.unaliasedBytes) - static_cast<double>(set.aliasedBytes) ) / set.unaliasedBytes << "% saved)";
+		}
+		out << std::endl;
+
+		for ( const auto &transient : set.images )
+		{
+			out << "  " << graph.imageName( transient.graphImage ) << ": " << transient.requirements.size / MiB << " MiB, passes "
+				<< graph.firstUse( transient.graphImage ) << "-" << graph.lastUse( transient.graphImage )
+				<< ", block " << transient.block << " at " << transient.offset / MiB << " MiB" << std::endl;
+		}
+
+		for ( size_t i = 0; i < set.blocks.size(); i++ )
+		{
+			const TransientBlock &block = set.blocks[i];
+			out << "  block " << i << ": " << block.allocation.size / MiB << " MiB";
+			if ( block.lazilyAllocated )
+			{
+				VkDeviceSize committed = 0;
+				vkGetDeviceMemoryCommitment( device, block.allocation.memory, &committed );
+				out << " lazy (" << committed / MiB << " MiB committed in its memory object)";
+			}
+			out << std::endl;
+		}
+		out.flags( flags );
+	}
+
+private:
+	VkImage createImage( const RenderGraph &graph, uint32_t graphImage, VkExtent2D extent )
+	{
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = graph.imageFormat( graphImage );
+		imageInfo.extent.width = extent.width;
+		imageInfo.extent.height = extent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = graph.imageSamples( graphImage );
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = graph.imageUsage( graphImage );
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VkImage image;
+		if ( vkCreateImage( device, &imageInfo, vulkanHostAllocator, &image ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create transient image!" );
+		}
+		return image;
+	}
+
+	// Depth formats are only ever viewed through their depth aspect
+	VkImageView createView( const RenderGraph &graph, const TransientImage &transient )
+	{
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = transient.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = graph.imageFormat( transient.graphImage );
+		viewInfo.subresourceRange.aspectMask = ( graph.imageUsage( transient.graphImage ) & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT ) ?
+			VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		VkImageView view;
+		if ( vkCreateImageView( device, &viewInfo, vulkanHostAllocator, &view ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create transient image view!" );
+		}
+		return view;
+	}
+
+	static bool overlaps( VkDeviceSize offset, VkDeviceSize size, VkDeviceSize otherOffset, VkDeviceSize otherSize )
+	{
+		return offset < otherOffset + otherSize && otherOffset < offset + size;
+	}
+
+	// Fills in each image's block and offset, and blockRequirements
+	void place( const RenderGraph &graph, TransientImageSet &set )
+	{
+		std::vector<size_t> order( set.images.size() );
+		for ( size_t i = 0; i < order.size(); i++ )
+		{
+			order[i] = i;
+		}
+		std::stable_sort( order.begin(), order.end(), [&set]( size_t a, size_t b ) { return set.images[a].requirements.size > set.images[b].requirements.size; } );
+
+		blockRequirements.clear();
+		std::vector<std::vector<size_t>> blockImages;
+		for ( size_t index : order )
+		{
+			TransientImage &transient = set.images[index];
+			const VkMemoryRequirements &requirements = transient.requirements;
+			uint32_t first = graph.firstUse( transient.graphImage );
+			uint32_t last = graph.lastUse( transient.graphImage );
+			bool lazy = ( graph.imageUsage( transient.graphImage ) & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT ) &&
+				allocator->hasMemoryType( requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT );
+			VkMemoryPropertyFlags memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | ( lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0 );
+
+			bool placed = false;
+			for ( size_t b = 0; aliasing && b < set.blocks.size() && !placed; b++ )
+			{
+				// The block's memory type has to suit every image in it, not
+				// just share a bit with this one's
+				uint32_t memoryTypeBits = blockRequirements[b].memoryTypeBits & requirements.memoryTypeBits;
+				if ( set.blocks[b].lazilyAllocated != lazy || !allocator->hasMemoryType( memoryTypeBits, memoryProperties ) )
+				{
+					continue;
+				}
+
+				// Candidate offsets are the start of the block and the ends of
+				// the images alive at the same time, the lowest free one wins
+				std::vector<VkDeviceSize> candidates = { 0 };
+				for ( size_t other : blockImages[b] )
+				{
+					const TransientImage &placedImage = set.images[other];
+					if ( livesDuring( graph, placedImage, first, last ) )
+					{
+						candidates.push_back( placedImage.offset + placedImage.requirements.size );
+					}
+				}
+				std::sort( candidates.begin(), candidates.end() );
+
+				for ( VkDeviceSize candidate : candidates )
+				{
+					VkDeviceSize offset = ( candidate + requirements.alignment - 1 ) / requirements.alignment * requirements.alignment;
+					bool free = true;
+					for ( size_t other : blockImages[b] )
+					{
+						const TransientImage &placedImage = set.images[other];
+						if ( livesDuring( graph, placedImage, first, last ) && overlaps( offset, requirements.size, placedImage.offset, placedImage.requirements.size ) )
+						{
+							free = false;
+							break;
+						}
+					}
+
+					if ( free )
+					{
+						transient.block = static_cast<uint32_t>(b);
+						transient.offset = offset;
+						VkMemoryRequirements &block = blockRequirements[b];
+						block.size = std::max( block.size, offset + requirements.size );
+						block.alignment = std::max( block.alignment, requirements.alignment );
+						block.memoryTypeBits = memoryTypeBits;
+						blockImages[b].push_back( index );
+						placed = true;
+						break;
+					}
+				}
+			}
+
+			if ( !placed )
+			{
+				TransientBlock block;
+				block.lazilyAllocated = lazy;
+				set.blocks.push_back( block );
+				blockRequirements.push_back( requirements );
+				blockImages.push_back( { index } );
+				transient.block = static_cast<uint32_t>(set.blocks.size() - 1);
+				transient.offset = 0;
+			}
+		}
+	}
+
+	// Whether the image is in use during any of the passes first to last
+	static bool livesDuring( const RenderGraph &graph, const TransientImage &transient, uint32_t first, uint32_t last )
+	{
+		return graph.firstUse( transient.graphImage ) <= last && first <= graph.lastUse( transient.graphImage );
+	}
+
+	VkDevice device = VK_NULL_HANDLE;
+	GpuAllocator *allocator = nullptr;
+	bool aliasing = true;
+
+	// Per block of the set being created, see place()
+	std::vector<VkMemoryRequirements> blockRequirements;
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include "gpu_allocator.h"
+#include "host_allocator.h"
+
+// -------------------------------------------------------------------------------------------------------------------------
+// One host-visible uniform buffer split into a region per frame slot, each
+// aligned to minUniformBufferOffsetAlignment and persistently mapped. A frame
+// writes its slot's region with a single memcpy and binds it as a
+// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC with offset(). No descriptor is
+// rewritten and nothing is allocated per frame. A slot's region is only
+// written once the slot's previous frame has completed.
+class UniformRing
+{
+public:
+	void init( VkDevice device, GpuAllocator &allocator, VkDeviceSize minAlignment, VkDeviceSize regionSize, uint32_t regionCount )
+	{
+		this->device = device;
+		this->allocator = &allocator;
+		this->regionSize = regionSize;
+		this->regionCount = regionCount;
+		regionStride = ( regionSize + minAlignment - 1 ) / minAlignment * minAlignment;
+
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = regionStride * regionCount;
+		bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if ( vkCreateBuffer( device, &bufferInfo, vulkanHostAllocator, &uniforms.buffer ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create uniform ring buffer!" );
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements( device, uniforms.buffer, &memRequirements );
+
+		uniforms.allocation = allocator.allocate( memRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true );
+		vkBindBufferMemory( device, uniforms.buffer, uniforms.allocation.memory, uniforms.allocation.offset );
+	}
+
+	void destroy()
+	{
+		if ( uniforms.buffer != VK_NULL_HANDLE )
+		{
+			vkDestroyBuffer( device, uniforms.buffer, vulkanHostAllocator );
+			allocator->free( uniforms.allocation );
+			uniforms.buffer = VK_NULL_HANDLE;
+		}
+	}
+
+	VkBuffer buffer() const
+	{
+		return uniforms.buffer;
+	}
+
+	// The range the descriptor covers, one region
+	VkDeviceSize range() const
+	{
+		return regionSize;
+	}
+
+	// Dynamic offset of a slot's region
+	uint32_t offset( size_t slot ) const
+	{
+		return static_cast<uint32_t>(slot * regionStride);
+	}
+
+	void write( size_t slot, const void *data, VkDeviceSize size )
+	{
+		if ( size > regionSize || slot >= regionCount )
+		{
+			throw std::runtime_error( "uniform ring write out of range!" );
+		}
+
+		memcpy( static_cast<char *>(uniforms.allocation.mapped) + offset( slot ), data, static_cast<size_t>(size) );
+		bytesWritten += size;
+		writeCount++;
+	}
+
+	void report( std::ostream &out ) const
+	{
+		std::ios::fmtflags flags = out.flags();
+		out << std::fixed << std::setprecision( 1 );
+		out << "Uniform ring: " << regionCount << " regions of " << regionSize << " bytes (" << regionStride << " byte stride), "
+			<< ( writeCount > 0 ? static_cast<double>(bytesWritten) / writeCount : 0.0 ) << " bytes written per frame, "
+			<< bytesWritten << " in total" << std::endl;
+		out.flags( flags );
+	}
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	GpuAllocator *allocator = nullptr;
+	GpuBuffer uniforms;
+	VkDeviceSize regionSize = 0;
+	VkDeviceSize regionStride = 0;
+	uint32_t regionCount = 0;
+
+	uint64_t bytesWritten = 0;
+	uint64_t writeCount = 0;
+};
@@ -0,0 +1,455 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "gpu_allocator.h"
+#include "host_allocator.h"
+
+// Offset alignment of upload ring allocations, enough for any texel block
+const VkDeviceSize UPLOAD_ALIGNMENT = 16;
+
+// Frame completion test shared by the upload ring and the buffer pool
+using FrameCompleteFunction = std::function<bool( uint64_t frame )>;
+
+// Space handed out by UploadRing::tryAllocate(). mapped points at offset in
+// the ring's persistently mapped staging buffer.
+struct UploadAllocation
+{
+	VkDeviceSize offset = 0;
+	void *mapped = nullptr;
+};
+
+// -------------------------------------------------------------------------------------------------------------------------
+// One fixed-size, persistently mapped staging buffer used as a ring. Every
+// frame appends its uploads after the previous frame's, and a frame's space is
+// reclaimed as a whole once that frame has completed on the GPU, so there is
+// no per-upload bookkeeping and nothing is ever mapped or allocated at runtime.
+//
+// Copies out of the ring are queued rather than recorded straight away, so one
+// vkCmdCopyBuffer or vkCmdCopyBufferToImage is recorded per destination with
+// all of the frame's regions for it.
+//
+// When the ring is full the caller waits for oldestPendingFrame() and calls
+// reclaim(), reporting the time spent with addStall().
+class UploadRing
+{
+public:
+	void init( VkDevice device, GpuAllocator &allocator, VkDeviceSize capacity )
+	{
+		this->device = device;
+		this->allocator = &allocator;
+		ringCapacity = capacity;
+
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = capacity;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if ( vkCreateBuffer( device, &bufferInfo, vulkanHostAllocator, &staging.buffer ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create upload ring buffer!" );
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements( device, staging.buffer, &memRequirements );
+
+		staging.allocation = allocator.allocate( memRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true );
+		vkBindBufferMemory( device, staging.buffer, staging.allocation.memory, staging.allocation.offset );
+	}
+
+	void destroy()
+	{
+		if ( staging.buffer != VK_NULL_HANDLE )
+		{
+			vkDestroyBuffer( device, staging.buffer, vulkanHostAllocator );
+			allocator->free( staging.allocation );
+			staging.buffer = VK_NULL_HANDLE;
+		}
+	}
+
+	VkBuffer buffer() const
+	{
+		return staging.buffer;
+	}
+
+	VkDeviceSize capacity() const
+	{
+		return ringCapacity;
+	}
+
+	// Allocations made from now on belong to frame
+	void beginFrame( uint64_t frame )
+	{
+		currentFrame = frame;
+		frameBytes = 0;
+	}
+
+	void endFrame()
+	{
+		if ( frameBytes > 0 )
+		{
+			uploadFrames++;
+			totalBytes += frameBytes;
+			maxFrameBytes = std::max( maxFrameBytes, frameBytes );
+		}
+	}
+
+	// Space for size bytes, or false when the ring is full until an older frame
+	// has completed. Requests that would run past the end of the ring start
+	// over at the beginning, the skipped tail is reclaimed with the frame.
+	bool tryAllocate( VkDeviceSize size, VkDeviceSize alignment, UploadAllocation &allocation )
+	{
+		VkDeviceSize offset = ( head + alignment - 1 ) / alignment * alignment;
+		VkDeviceSize padding = offset - head;
+		if ( offset + size > ringCapacity )
+		{
+			offset = 0;
+			padding = ringCapacity - head;
+		}
+
+		if ( used + padding + size > ringCapacity )
+		{
+			return false;
+		}
+
+		if ( frames.empty() || frames.back().frame != currentFrame )
+		{
+			frames.push_back( { currentFrame, 0 } );
+		}
+		frames.back().bytes += padding + size;
+
+		used += padding + size;
+		head = offset + size;
+		frameBytes += size;
+
+		allocation.offset = offset;
+		allocation.mapped = static_cast<char *>(staging.allocation.mapped) + offset;
+		return true;
+	}
+
+	// The frame to wait for when the ring is full, UINT64_MAX when the current
+	// frame is the only one holding space and the request can never fit
+	uint64_t oldestPendingFrame() const
+	{
+		if ( frames.empty() || frames.front().frame == currentFrame )
+		{
+			return UINT64_MAX;
+		}
+		return frames.front().frame;
+	}
+
+	// Releases the space of completed frames, oldest first
+	void reclaim( const FrameCompleteFunction &isFrameComplete )
+	{
+		while ( !frames.empty() && frames.front().frame != currentFrame && isFrameComplete( frames.front().frame ) )
+		{
+			used -= frames.front().bytes;
+			frames.pop_front();
+		}
+
+		if ( used == 0 )
+		{
+			head = 0;
+		}
+	}
+
+	double meanFrameBytes() const
+	{
+		return uploadFrames > 0 ? static_cast<double>(totalBytes) / uploadFrames : 0.0;
+	}
+
+	double totalStallMs() const
+	{
+		return stallMs;
+	}
+
+	void addStall( double ms )
+	{
+		stallCount++;
+		stallMs += ms;
+	}
+
+	// Queues a copy of size bytes at allocation into buffer
+	void copyToBuffer( const UploadAllocation &allocation, VkDeviceSize size, VkBuffer destination, VkDeviceSize destinationOffset )
+	{
+		VkBufferCopy region = {};
+		region.srcOffset = allocation.offset;
+		region.dstOffset = destinationOffset;
+		region.size = size;
+
+		for ( auto &copy : bufferCopies )
+		{
+			if ( copy.destination == destination )
+			{
+				copy.regions.push_back( region );
+				return;
+			}
+		}
+		bufferCopies.push_back( { destination, { region } } );
+	}
+
+	// Queues a copy into image, which must be in TRANSFER_DST_OPTIMAL layout by
+	// the time the copies are recorded. region.bufferOffset is filled in.
+	void copyToImage( const UploadAllocation &allocation, VkImage destination, VkBufferImageCopy region )
+	{
+		region.bufferOffset = allocation.offset;
+
+		for ( auto &copy : imageCopies )
+		{
+			if ( copy.destination == destination )
+			{
+				copy.regions.push_back( region );
+				return;
+			}
+		}
+		imageCopies.push_back( { destination, { region } } );
+	}
+
+	bool hasPendingCopies() const
+	{
+		return !bufferCopies.empty() || !imageCopies.empty();
+	}
+
+	std::vector<VkBuffer> pendingBufferDestinations() const
+	{
+		std::vector<VkBuffer> destinations;
+		for ( const auto &copy : bufferCopies )
+		{
+			destinations.push_back( copy.destination );
+		}
+		return destinations;
+	}
+
+	// Records every queued copy, one command per destination, and empties the queue
+	void recordCopies( VkCommandBuffer commandBuffer )
+	{
+		for ( const auto &copy : bufferCopies )
+		{
+			vkCmdCopyBuffer( commandBuffer, staging.buffer, copy.destination, static_cast<uint32_t>(copy.regions.size()), copy.regions.data() );
+			copyCommands++;
+			copyRegions += copy.regions.size();
+		}
+
+		for ( const auto &copy : imageCopies )
+		{
+			vkCmdCopyBufferToImage( commandBuffer, staging.buffer, copy.destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<uint32_t>(copy.regions.size()), copy.regions.data() );
+			copyCommands++;
+			copyRegions += copy.regions.size();
+		}
+
+		bufferCopies.clear();
+		imageCopies.clear();
+	}
+
+	void report( std::ostream &out ) const
+	{
+		std::ios::fmtflags flags = out.flags();
+		out << std::fixed << std::setprecision( 2 );
+		out << "Upload ring: " << ringCapacity / 1024.0 << " KiB, " << uploadFrames << " frames uploaded "
+			<< ( uploadFrames > 0 ? totalBytes / 1024.0 / uploadFrames : 0.0 ) << " KiB/frame on average ("
+			<< maxFrameBytes / 1024.0 << " KiB max), " << copyRegions << " regions in " << copyCommands << " copy commands, "
+			<< stallCount << " stalls on a full ring totalling " << stallMs << " ms" << std::endl;
+		out.flags( flags );
+	}
+
+private:
+	template <typename Region, typename Destination>
+	struct PendingCopy
+	{
+		Destination destination;
+		std::vector<Region> regions;
+	};
+
+	struct FrameSpan
+	{
+		uint64_t frame;
+		VkDeviceSize bytes;	// including alignment padding and a skipped tail
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	GpuAllocator *allocator = nullptr;
+	GpuBuffer staging;
+	VkDeviceSize ringCapacity = 0;
+
+	VkDeviceSize head = 0;
+	VkDeviceSize used = 0;
+	uint64_t currentFrame = 0;
+	std::deque<FrameSpan> frames;
+
+	std::vector<PendingCopy<VkBufferCopy, VkBuffer>> bufferCopies;
+	std::vector<PendingCopy<VkBufferImageCopy, VkImage>> imageCopies;
+
+	VkDeviceSize frameBytes = 0;
+	VkDeviceSize totalBytes = 0;
+	VkDeviceSize maxFrameBytes = 0;
+	uint64_t uploadFrames = 0;
+	uint64_t copyCommands = 0;
+	uint64_t copyRegions = 0;
+	uint64_t stallCount = 0;
+	double stallMs = 0.0;
+};
+
+// -------------------------------------------------------------------------------------------------------------------------
+// Device-local buffers that are rewritten every frame. A buffer handed back
+// with release() becomes available again once the frame that last used it has
+// completed, so steady-state streaming reuses the same few buffers instead of
+// creating and freeing one per frame. Sizes are rounded up to a power of two
+// so slightly growing requests still hit the pool.
+class BufferPool
+{
+public:
+	void init( VkDevice device, GpuAllocator &allocator )
+	{
+		this->device = device;
+		this->allocator = &allocator;
+	}
+
+	void destroy()
+	{
+		for ( auto &entry : freeBuffers )
+		{
+			destroyBuffer( entry.buffer );
+		}
+		for ( auto &entry : pendingBuffers )
+		{
+			destroyBuffer( entry.buffer );
+		}
+		freeBuffers.clear();
+		pendingBuffers.clear();
+	}
+
+	GpuBuffer acquire( VkDeviceSize size, VkBufferUsageFlags usage )
+	{
+		// Smallest free buffer that is large enough
+		auto best = freeBuffers.end();
+		for ( auto it = freeBuffers.begin(); it != freeBuffers.end(); ++it )
+		{
+			if ( it->size >= size && ( it->usage & usage ) == usage && ( best == freeBuffers.end() || it->size < best->size ) )
+			{
+				best = it;
+			}
+		}
+
+		if ( best != freeBuffers.end() )
+		{
+			GpuBuffer buffer = best->buffer;
+			inUse.push_back( *best );
+			freeBuffers.erase( best );
+			reusedCount++;
+			return buffer;
+		}
+
+		Entry entry;
+		entry.size = MIN_BUFFER_SIZE;
+		while ( entry.size < size )
+		{
+			entry.size *= 2;
+		}
+		entry.usage = usage;
+		createBuffer( entry );
+
+		inUse.push_back( entry );
+		createdCount++;
+		bytesPooled += entry.size;
+		return entry.buffer;
+	}
+
+	// buffer may be handed out again once frame has completed
+	void release( const GpuBuffer &buffer, uint64_t frame )
+	{
+		for ( auto it = inUse.begin(); it != inUse.end(); ++it )
+		{
+			if ( it->buffer.buffer == buffer.buffer )
+			{
+				it->frame = frame;
+				pendingBuffers.push_back( *it );
+				inUse.erase( it );
+				return;
+			}
+		}
+	}
+
+	void recycle( const FrameCompleteFunction &isFrameComplete )
+	{
+		for ( auto it = pendingBuffers.begin(); it != pendingBuffers.end(); )
+		{
+			if ( isFrameComplete( it->frame ) )
+			{
+				freeBuffers.push_back( *it );
+				it = pendingBuffers.erase( it );
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	void report( std::ostream &out ) const
+	{
+		std::ios::fmtflags flags = out.flags();
+		out << std::fixed << std::setprecision( 2 );
+		out << "Buffer pool: " << createdCount << " buffers created (" << bytesPooled / 1024.0 << " KiB), "
+			<< reusedCount << " acquisitions served by recycled buffers" << std::endl;
+		out.flags( flags );
+	}
+
+private:
+	static constexpr VkDeviceSize MIN_BUFFER_SIZE = 64 * 1024;
+
+	struct Entry
+	{
+		GpuBuffer buffer;
+		VkDeviceSize size = 0;
+		VkBufferUsageFlags usage = 0;
+		uint64_t frame = 0;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	GpuAllocator *allocator = nullptr;
+
+	std::vector<Entry> freeBuffers;
+	std::vector<Entry> pendingBuffers;
+	std::vector<Entry> inUse;
+
+	uint64_t createdCount = 0;
+	uint64_t reusedCount = 0;
+	VkDeviceSize bytesPooled = 0;
+
+	void createBuffer( Entry &entry )
+	{
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = entry.size;
+		bufferInfo.usage = entry.usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if ( vkCreateBuffer( device, &bufferInfo, vulkanHostAllocator, &entry.buffer.buffer ) != VK_SUCCESS )
+		{
+			throw std::runtime_error( "failed to create pooled buffer!" );
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements( device, entry.buffer.buffer, &memRequirements );
+
+		entry.buffer.allocation = allocator->allocate( memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true );
+		vkBindBufferMemory( device, entry.buffer.buffer, entry.buffer.allocation.memory, entry.buffer.allocation.offset );
+	}
+
+	void destroyBuffer( GpuBuffer &buffer )
+	{
+		vkDestroyBuffer( device, buffer.buffer, vulkanHostAllocator );
+		allocator->free( buffer.allocation );
+	}
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// -------------------------------------------------------------------------------------------------------------------------
+// A fixed set of persistent worker threads that all run the same task and are
+// waited on together, fork/join style. Each invocation receives the index of
+// the worker running it, which callers use to pick per-thread resources such
+// as command pools without any locking.
+class WorkerPool
+{
+public:
+	explicit WorkerPool( uint32_t workerCount )
+	{
+		for ( uint32_t i = 0; i < workerCount; i++ )
+		{
+			threads.emplace_back( &WorkerPool::workerMain, this, i );
+		}
+	}
+
+	~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock( mutex );
+			stopping = true;
+		}
+		workAvailable.notify_all();
+
+		for ( auto &thread : threads )
+		{
+			thread.join();
+		}
+	}
+
+	WorkerPool( const WorkerPool & ) = delete;
+	WorkerPool &operator=( const WorkerPool & ) = delete;
+
+	uint32_t size() const
+	{
+		return static_cast<uint32_t>(threads.size());
+	}
+
+	// Runs task( workerIndex ) once on every worker and blocks until all of them
+	// have returned. The first exception thrown by a worker is rethrown here.
+	void runOnAll( const std::function<void( uint32_t )> &task )
+	{
+		std::unique_lock<std::mutex> lock( mutex );
+		currentTask = &task;
+		remaining = size();
+		failure = nullptr;
+		generation++;
+		workAvailable.notify_all();
+
+		workDone.wait( lock, [this] { return remaining == 0; } );
+		currentTask = nullptr;
+
+		if ( failure )
+		{
+			std::rethrow_exception( failure );
+		}
+	}
+
+private:
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable workDone;
+
+	const std::function<void( uint32_t )> *currentTask = nullptr;
+	uint64_t generation = 0;
+	uint32_t remaining = 0;
+	bool stopping = false;
+	std::exception_ptr failure;
+
+	void workerMain( uint32_t workerIndex )
+	{
+		uint64_t seenGeneration = 0;
+
+		for ( ;; )
+		{
+			const std::function<void( uint32_t )> *task;
+			{
+				std::unique_lock<std::mutex> lock( mutex );
+				workAvailable.wait( lock, [&] { return stopping || generation != seenGeneration; } );
+				if ( stopping )
+				{
+					return;
+				}
+				seenGeneration = generation;
+				task = currentTask;
+			}
+
+			std::exception_ptr error;
+			try
+			{
+				( *task )( workerIndex );
+			}
+			catch ( ... )
+			{
+				error = std::current_exception();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock( mutex );
+				if ( error && !failure )
+				{
+					failure = error;
+				}
+				if ( --remaining == 0 )
+				{
+					workDone.notify_one();
+				}
+			}
+		}
+	}
+};